@@ -0,0 +1,177 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <iso646.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "cache.h"
+
+#define CACHE_SIGNATURE "WCCACHE1"
+/* bumped whenever an entry changes, the entry size catches builds that lay it out differently */
+#define CACHE_VERSION 2
+#define CACHE_SAMPLE 4096
+#define LEN(arr) (sizeof(arr) / sizeof(arr[0]))
+
+static int compare_entries(const void *a, const void *b) {
+	const struct cache_entry *x = a, *y = b;
+	if (x->dev != y->dev)
+		return x->dev < y->dev ? -1 : 1;
+	if (x->ino != y->ino)
+		return x->ino < y->ino ? -1 : 1;
+	return 0;
+}
+
+/* every entry is followed by the length of its path and the path without the NUL */
+static int read_entry(FILE *file, struct cache_entry *entry) {
+	unsigned length;
+	if (fread(entry, sizeof *entry, 1, file) != 1 or fread(&length, sizeof length, 1, file) != 1 or
+			length == 0 or length >= PATH_MAX or (entry->path = malloc(length + 1)) == NULL)
+		return 1;
+	entry->path[length] = '\0';
+	if (fread(entry->path, 1, length, file) != length or strlen(entry->path) != length) {
+		free(entry->path);
+		return 1;
+	}
+	return 0;
+}
+
+/* a missing cache file is an empty cache, a foreign or older one is an error */
+int cache_load(const char *filename, struct cache *cache) {
+	char signature[LEN(CACHE_SIGNATURE)];
+	unsigned version[2];
+	unsigned long long count;
+	struct stat info;
+	FILE *file = fopen(filename, "rb");
+
+	memset(cache, 0, sizeof *cache);
+	if (file == NULL)
+		return 0;
+
+	if (fstat(fileno(file), &info) != 0 or
+			fread(signature, 1, LEN(signature), file) != LEN(signature) or
+			memcmp(signature, CACHE_SIGNATURE, LEN(signature)) != 0 or
+			fread(version, sizeof version, 1, file) != 1 or
+			version[0] != CACHE_VERSION or version[1] != sizeof(struct cache_entry) or
+			fread(&count, sizeof count, 1, file) != 1 or
+			count > (unsigned long long)info.st_size / (sizeof(struct cache_entry) + sizeof(unsigned))) {
+		fclose(file);
+		return 1;
+	}
+	cache->entries = malloc(count * sizeof(struct cache_entry));
+	cache->capacity = count;
+	if (count > 0 and cache->entries == NULL) {
+		fclose(file);
+		return 1;
+	}
+	while (cache->count < count and read_entry(file, &cache->entries[cache->count]) == 0)
+		cache->count++;
+	fclose(file);
+	/* entries are saved sorted, this only guards against hand-edited files */
+	qsort(cache->entries, cache->count, sizeof(struct cache_entry), compare_entries);
+	return cache->count != count;
+}
+
+/* the file of the entry was removed or replaced since it was counted */
+static bool is_gone(const struct cache_entry *entry) {
+	struct stat info;
+	return stat(entry->path, &info) != 0 or (unsigned long long)info.st_dev != entry->dev or
+		(unsigned long long)info.st_ino != entry->ino;
+}
+
+/* writes a temporary file next to the cache and renames it over, readers never see half a cache */
+int cache_save(const char *filename, struct cache *cache) {
+	char temp[strlen(filename) + 5];
+	unsigned long long count = 0;
+	FILE *file;
+
+	unsigned version[2] = { CACHE_VERSION, sizeof(struct cache_entry) };
+
+	qsort(cache->entries, cache->count, sizeof(struct cache_entry), compare_entries);
+	/* the same file may have been listed twice, the later entry is the newer one */
+	for (size_t i = 0; i < cache->count; i++) {
+		struct cache_entry *entry = &cache->entries[i];
+		if (is_gone(entry)) {
+			free(entry->path);
+		}
+		else if (count > 0 and compare_entries(&cache->entries[count - 1], entry) == 0) {
+			free(cache->entries[count - 1].path);
+			cache->entries[count - 1] = *entry;
+		}
+		else {
+			cache->entries[count++] = *entry;
+		}
+	}
+	cache->count = count;
+
+	sprintf(temp, "%s.tmp", filename);
+	file = fopen(temp, "wb");
+	if (file == NULL)
+		return 1;
+	fwrite(CACHE_SIGNATURE, 1, LEN(CACHE_SIGNATURE), file);
+	fwrite(version, sizeof version, 1, file);
+	fwrite(&count, sizeof count, 1, file);
+	for (size_t i = 0; i < count; i++) {
+		unsigned length = strlen(cache->entries[i].path);
+		fwrite(&cache->entries[i], sizeof(struct cache_entry), 1, file);
+		fwrite(&length, sizeof length, 1, file);
+		fwrite(cache->entries[i].path, 1, length, file);
+	}
+	if (fclose(file) != 0 or rename(temp, filename) != 0) {
+		remove(temp);
+		return 1;
+	}
+	return 0;
+}
+
+void cache_free(struct cache *cache) {
+	for (size_t i = 0; i < cache->count; i++)
+		free(cache->entries[i].path);
+	free(cache->entries);
+	memset(cache, 0, sizeof *cache);
+}
+
+/* the entries must be sorted, so look everything up before the first cache_put */
+const struct cache_entry *cache_find(const struct cache *cache, dev_t dev, ino_t ino) {
+	struct cache_entry key = { .dev = dev, .ino = ino };
+	if (cache->count == 0)
+		return NULL;
+	return bsearch(&key, cache->entries, cache->count, sizeof(struct cache_entry), compare_entries);
+}
+
+/* appends without keeping the order, cache_save sorts once at the end; takes over the path */
+void cache_put(struct cache *cache, const struct cache_entry *entry) {
+	if (cache->count == cache->capacity) {
+		size_t capacity = cache->capacity ? cache->capacity * 2 : 64;
+		struct cache_entry *entries = realloc(cache->entries, capacity * sizeof(struct cache_entry));
+		if (entries == NULL) {
+			free(entry->path);
+			return;
+		}
+		cache->entries = entries;
+		cache->capacity = capacity;
+	}
+	cache->entries[cache->count++] = *entry;
+}
+
+/*
+ * FNV-1a over the size and the first and last CACHE_SAMPLE bytes of the first size bytes.
+ * Hashing the whole prefix would cost as much as counting it again, the samples catch
+ * truncated, rotated and rewritten files.
+ */
+int cache_hash(int fd, unsigned long long size, unsigned long long *hash) {
+	unsigned char sample[2 * CACHE_SAMPLE];
+	size_t head = size < CACHE_SAMPLE ? size : CACHE_SAMPLE,
+		tail = size - head < CACHE_SAMPLE ? size - head : CACHE_SAMPLE;
+
+	if (pread(fd, sample, head, 0) != (ssize_t)head or
+			pread(fd, sample + head, tail, size - tail) != (ssize_t)tail)
+		return 1;
+
+	*hash = 0xcbf29ce484222325ULL;
+	for (int i = 0; i < 8; i++)
+		*hash = (*hash ^ (size >> 8 * i & 0xff)) * 0x100000001b3ULL;
+	for (size_t i = 0; i < head + tail; i++)
+		*hash = (*hash ^ sample[i]) * 0x100000001b3ULL;
+	return 0;
+}
@@ -0,0 +1,32 @@
+#ifndef CACHE_INCLUDED
+#define CACHE_INCLUDED
+
+#include <stdbool.h>
+#include <sys/types.h>
+#include "count.h"
+
+/* counts of a file up to size bytes and the state to resume counting from */
+struct cache_entry {
+	unsigned long long dev, ino, size;
+	/* hash of the first and last CACHE_SAMPLE bytes of the counted prefix */
+	unsigned long long hash;
+	bool unicode_spaces;
+	struct counts counts;
+	struct count_state state;
+	/* absolute, owned by the cache, entries whose file is gone are dropped on save */
+	char *path;
+};
+
+struct cache {
+	struct cache_entry *entries;
+	size_t count, capacity;
+};
+
+int cache_load(const char *filename, struct cache *cache);
+int cache_save(const char *filename, struct cache *cache);
+void cache_free(struct cache *cache);
+const struct cache_entry *cache_find(const struct cache *cache, dev_t dev, ino_t ino);
+void cache_put(struct cache *cache, const struct cache_entry *entry);
+int cache_hash(int fd, unsigned long long size, unsigned long long *hash);
+
+#endif
@@ -0,0 +1,343 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <iso646.h>
+#include <pthread.h>
+#include "count.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86
+#endif
+
+/* every kernel classifies 64 bytes into 64-bit masks at a time */
+#define BLOCK 64
+
+#define ONES  0x0101010101010101ULL
+#define HIGHS 0x8080808080808080ULL
+
+struct partition {
+	const char *data;
+	size_t start, end;
+	struct counts counts;
+	struct count_state state;
+};
+
+typedef void (*kernel_t)(const unsigned char *buf, size_t len, struct counts *counts, struct count_state *state);
+
+static bool unicode_spaces;
+
+static inline bool is_space(unsigned char c) {
+	return c == ' ' or (c >= '\t' and c <= '\r');
+}
+
+/*
+ * Classifies a non-ASCII byte by the Unicode White_Space property of its character.
+ * A byte keeps the class of the previous one until its character is known to be
+ * a space or not, so only one byte of every character can start a word.
+ */
+static bool utf8_space(unsigned char c, struct count_state *state) {
+	bool keep = not state->in_word;
+	uint32_t seq = (uint32_t)state->utf8 << 8 | c;
+
+	state->utf8 = 0;
+	if ((c & 0xc0) != 0x80) {
+		/* lead bytes of U+0085, U+00A0, U+1680, U+2000..U+205F and U+3000 */
+		if (c == 0xc2 or (c >= 0xe1 and c <= 0xe3)) {
+			state->utf8 = c;
+			return keep;
+		}
+		return false;
+	}
+	if (seq == c)
+		return keep;
+
+	switch (seq) {
+		case 0xe19a: case 0xe280: case 0xe281: case 0xe380:
+			state->utf8 = seq;
+			return keep;
+		case 0xc285: case 0xc2a0: case 0xe19a80: case 0xe2819f: case 0xe38080:
+		case 0xe280a8: case 0xe280a9: case 0xe280af:
+			return true;
+	}
+	return seq >= 0xe28080 and seq <= 0xe2808a;
+}
+
+static inline bool byte_space(unsigned char c, bool unicode, struct count_state *state) {
+	if (c >= 0x80 and unicode)
+		return utf8_space(c, state);
+	state->utf8 = 0;
+	return is_space(c);
+}
+
+/* the class of c after the bytes state was built from, the caller sets in_word from it */
+bool count_space(unsigned char c, bool unicode, struct count_state *state) {
+	return byte_space(c, unicode, state);
+}
+
+static void count_scalar(const unsigned char *buf, size_t len, struct counts *counts, struct count_state *state) {
+	for (size_t i = 0; i < len; i++) {
+		bool space = byte_space(buf[i], unicode_spaces, state), newline = buf[i] == '\n';
+		counts->chars += (buf[i] & 0xc0) != 0x80;
+		counts->words += not space and not state->in_word;
+		counts->not_empty_lines += not newline and not state->in_line;
+		counts->lines += newline;
+		state->in_word = not space;
+		state->in_line = not newline;
+	}
+}
+
+/*
+ * Bit i of a mask describes byte i of the block, bit 0 is shifted in from the previous block.
+ * Returns false without counting when the block needs the scalar Unicode path.
+ */
+static inline bool count_masks(uint64_t space, uint64_t newline, uint64_t high, uint64_t cont,
+		struct counts *counts, struct count_state *state) {
+	if (unicode_spaces and (high or state->utf8))
+		return false;
+
+	uint64_t prev_space = space << 1 | !state->in_word;
+	uint64_t prev_newline = newline << 1 | !state->in_line;
+
+	counts->chars += BLOCK - __builtin_popcountll(cont);
+	counts->words += __builtin_popcountll(~space & prev_space);
+	counts->not_empty_lines += __builtin_popcountll(~newline & prev_newline);
+	counts->lines += __builtin_popcountll(newline);
+	state->in_word = not (space >> 63);
+	state->in_line = not (newline >> 63);
+	return true;
+}
+
+static inline uint64_t load64(const unsigned char *p) {
+	uint64_t v;
+	memcpy(&v, p, sizeof v);
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	v = __builtin_bswap64(v);
+#endif
+	return v;
+}
+
+/* gathers high bits of 8 bytes into the low 8 bits */
+static inline uint64_t swar_movemask(uint64_t v) {
+	return (v & HIGHS) * 0x0002040810204081ULL >> 56;
+}
+
+/* high bit of a byte is set if it equals zero, v must have high bits cleared */
+static inline uint64_t swar_zero(uint64_t v) {
+	return ~(v + 0x7f * ONES) & HIGHS;
+}
+
+static void count_swar(const unsigned char *buf, size_t len, struct counts *counts, struct count_state *state) {
+	size_t i = 0;
+	for (; i + BLOCK <= len; i += BLOCK) {
+		uint64_t space = 0, newline = 0, high = 0, cont = 0;
+		for (int j = 0; j < BLOCK / 8; j++) {
+			uint64_t v = load64(buf + i + 8 * j), low = v & ~HIGHS, ascii = ~v & HIGHS;
+			/* no carries between bytes: 0x7f + 0x77 still fits */
+			uint64_t ge_tab = (low + (0x80 - '\t') * ONES) & HIGHS;
+			uint64_t gt_cr = (low + (0x80 - '\r' - 1) * ONES) & HIGHS;
+			uint64_t s = (swar_zero(low ^ ' ' * ONES) | (ge_tab & ~gt_cr)) & ascii;
+			uint64_t n = swar_zero(low ^ '\n' * ONES) & ascii;
+			space |= swar_movemask(s) << 8 * j;
+			newline |= swar_movemask(n) << 8 * j;
+			if (~ascii & HIGHS) {
+				/* continuation bytes are 10xxxxxx */
+				high |= swar_movemask(v) << 8 * j;
+				cont |= swar_movemask(v & ~(v << 1)) << 8 * j;
+			}
+		}
+		if (not count_masks(space, newline, high, cont, counts, state))
+			count_scalar(buf + i, BLOCK, counts, state);
+	}
+	count_scalar(buf + i, len - i, counts, state);
+}
+
+#ifdef HAVE_X86
+__attribute__((target("sse2")))
+static void count_sse2(const unsigned char *buf, size_t len, struct counts *counts, struct count_state *state) {
+	const __m128i sp = _mm_set1_epi8(' '), nl = _mm_set1_epi8('\n'),
+		tab = _mm_set1_epi8('\t'), range = _mm_set1_epi8('\r' - '\t'), lead = _mm_set1_epi8(-64);
+	size_t i = 0;
+	for (; i + BLOCK <= len; i += BLOCK) {
+		uint64_t space = 0, newline = 0, high = 0, cont = 0;
+		for (int j = 0; j < BLOCK / 16; j++) {
+			__m128i x = _mm_loadu_si128((const __m128i *)(buf + i + 16 * j));
+			/* '\t'..'\r' is the only range where x - '\t' <= '\r' - '\t' unsigned */
+			__m128i shifted = _mm_sub_epi8(x, tab);
+			__m128i s = _mm_or_si128(_mm_cmpeq_epi8(x, sp),
+				_mm_cmpeq_epi8(_mm_min_epu8(shifted, range), shifted));
+			space |= (uint64_t)_mm_movemask_epi8(s) << 16 * j;
+			newline |= (uint64_t)_mm_movemask_epi8(_mm_cmpeq_epi8(x, nl)) << 16 * j;
+			if (_mm_movemask_epi8(x)) {
+				/* continuation bytes are the only ones below -64 as signed */
+				high |= (uint64_t)_mm_movemask_epi8(x) << 16 * j;
+				cont |= (uint64_t)_mm_movemask_epi8(_mm_cmpgt_epi8(lead, x)) << 16 * j;
+			}
+		}
+		if (not count_masks(space, newline, high, cont, counts, state))
+			count_scalar(buf + i, BLOCK, counts, state);
+	}
+	count_scalar(buf + i, len - i, counts, state);
+}
+
+__attribute__((target("avx2,popcnt")))
+static void count_avx2(const unsigned char *buf, size_t len, struct counts *counts, struct count_state *state) {
+	const __m256i sp = _mm256_set1_epi8(' '), nl = _mm256_set1_epi8('\n'),
+		tab = _mm256_set1_epi8('\t'), range = _mm256_set1_epi8('\r' - '\t'), lead = _mm256_set1_epi8(-64);
+	size_t i = 0;
+	for (; i + BLOCK <= len; i += BLOCK) {
+		uint64_t space = 0, newline = 0, high = 0, cont = 0;
+		for (int j = 0; j < BLOCK / 32; j++) {
+			__m256i x = _mm256_loadu_si256((const __m256i *)(buf + i + 32 * j));
+			__m256i shifted = _mm256_sub_epi8(x, tab);
+			__m256i s = _mm256_or_si256(_mm256_cmpeq_epi8(x, sp),
+				_mm256_cmpeq_epi8(_mm256_min_epu8(shifted, range), shifted));
+			space |= (uint64_t)(uint32_t)_mm256_movemask_epi8(s) << 32 * j;
+			newline |= (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(x, nl)) << 32 * j;
+			if (_mm256_movemask_epi8(x)) {
+				high |= (uint64_t)(uint32_t)_mm256_movemask_epi8(x) << 32 * j;
+				cont |= (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpgt_epi8(lead, x)) << 32 * j;
+			}
+		}
+		if (not count_masks(space, newline, high, cont, counts, state))
+			count_scalar(buf + i, BLOCK, counts, state);
+	}
+	count_scalar(buf + i, len - i, counts, state);
+}
+#endif
+
+static const struct {
+	const char *name;
+	kernel_t run;
+} KERNELS[] = {
+#ifdef HAVE_X86
+	{ "avx2", count_avx2 },
+	{ "sse2", count_sse2 },
+#endif
+	{ "swar", count_swar },
+	{ "scalar", count_scalar }
+};
+
+static int kernel;
+
+/* picks the widest kernel the CPU supports, WORDCOUNT_KERNEL=name forces one */
+__attribute__((constructor))
+static void select_kernel(void) {
+	const char *forced = getenv("WORDCOUNT_KERNEL");
+	int count = sizeof(KERNELS) / sizeof(KERNELS[0]);
+
+#ifdef HAVE_X86
+	__builtin_cpu_init();
+#endif
+	for (kernel = 0; kernel < count - 1; kernel++) {
+		if (forced != NULL) {
+			if (strcmp(forced, KERNELS[kernel].name) == 0)
+				break;
+			continue;
+		}
+#ifdef HAVE_X86
+		if (KERNELS[kernel].run == count_avx2 and __builtin_cpu_supports("avx2")
+				and __builtin_cpu_supports("popcnt"))
+			break;
+		if (KERNELS[kernel].run == count_sse2 and __builtin_cpu_supports("sse2"))
+			break;
+#endif
+		if (KERNELS[kernel].run == count_swar)
+			break;
+	}
+}
+
+void count_unicode_spaces(bool enable) {
+	unicode_spaces = enable;
+}
+
+void count_init(struct counts *counts, struct count_state *state) {
+	memset(counts, 0, sizeof *counts);
+	state->in_word = false;
+	state->in_line = false;
+	state->utf8 = 0;
+}
+
+void count_block(const char *buf, size_t len, struct counts *counts, struct count_state *state) {
+	counts->bytes += len;
+	KERNELS[kernel].run((const unsigned char *)buf, len, counts, state);
+}
+
+/*
+ * The last byte before start whose class does not depend on the bytes before it: ASCII or
+ * a lead byte that cannot start a space. Continuation bytes keep the class of the byte
+ * before them however many there are, so there is no limit on how far back it is.
+ */
+size_t count_fresh_start(const char *data, size_t start) {
+	const unsigned char *p = (const unsigned char *)data;
+	while (start > 0) {
+		unsigned char c = p[--start];
+		if (c < 0x80 or ((c & 0xc0) != 0x80 and c != 0xc2 and not (c >= 0xe1 and c <= 0xe3)))
+			break;
+	}
+	return start;
+}
+
+/* state as if data[0..start) was already counted, replayed from the last byte that fixes it */
+void count_seed(struct count_state *state, const char *data, size_t start) {
+	struct counts ignored;
+	size_t from = count_fresh_start(data, start);
+
+	count_init(&ignored, state);
+	count_scalar((const unsigned char *)data + from, start - from, &ignored, state);
+}
+
+void count_add(struct counts *total, const struct counts *part) {
+	total->lines += part->lines;
+	total->not_empty_lines += part->not_empty_lines;
+	total->bytes += part->bytes;
+	total->words += part->words;
+	total->chars += part->chars;
+}
+
+static void *count_partition(void *arg) {
+	struct partition *part = arg;
+
+	count_init(&part->counts, &part->state);
+	/* the bytes before the range decide whether its first word or line was already counted */
+	count_seed(&part->state, part->data, part->start);
+	count_block(part->data + part->start, part->end - part->start, &part->counts, &part->state);
+	return NULL;
+}
+
+/*
+ * Counts data[start..len) in jobs ranges on separate threads, the result equals a single pass.
+ * Counts are added to counts, state is the one at start on entry and the one at len on return.
+ */
+void count_parallel(const char *data, size_t start, size_t len, int jobs,
+		struct counts *counts, struct count_state *state) {
+	if ((size_t)jobs > len - start)
+		jobs = len - start;
+	if (jobs < 2) {
+		count_block(data + start, len - start, counts, state);
+		return;
+	}
+
+	struct partition parts[jobs];
+	pthread_t threads[jobs];
+	bool started[jobs];
+
+	for (int i = 0; i < jobs; i++) {
+		parts[i].data = data;
+		parts[i].start = start + (len - start) / jobs * i;
+		parts[i].end = i == jobs - 1 ? len : start + (len - start) / jobs * (i + 1);
+	}
+	/* a thread that failed to start is counted inline, the caller takes the first range itself */
+	for (int i = 1; i < jobs; i++)
+		started[i] = pthread_create(&threads[i], NULL, count_partition, &parts[i]) == 0;
+	count_block(data + start, parts[0].end - start, counts, state);
+
+	for (int i = 1; i < jobs; i++) {
+		if (started[i])
+			pthread_join(threads[i], NULL);
+		else
+			count_partition(&parts[i]);
+		count_add(counts, &parts[i].counts);
+	}
+	*state = parts[jobs - 1].state;
+}
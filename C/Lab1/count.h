@@ -0,0 +1,33 @@
+#ifndef COUNT_INCLUDED
+#define COUNT_INCLUDED
+
+#include <stddef.h>
+#include <stdbool.h>
+
+struct counts {
+	unsigned long long lines;
+	unsigned long long not_empty_lines;
+	unsigned long long bytes;
+	unsigned long long words;
+	unsigned long long chars;
+};
+
+/* carried between blocks, so words and lines split by a block boundary are counted once */
+struct count_state {
+	bool in_word;
+	bool in_line;
+	/* first bytes of a character that may still turn out to be a Unicode space */
+	unsigned short utf8;
+};
+
+void count_unicode_spaces(bool enable);
+bool count_space(unsigned char c, bool unicode, struct count_state *state);
+void count_init(struct counts *counts, struct count_state *state);
+size_t count_fresh_start(const char *data, size_t start);
+void count_seed(struct count_state *state, const char *data, size_t start);
+void count_add(struct counts *total, const struct counts *part);
+void count_block(const char *buf, size_t len, struct counts *counts, struct count_state *state);
+void count_parallel(const char *data, size_t start, size_t len, int jobs,
+		struct counts *counts, struct count_state *state);
+
+#endif
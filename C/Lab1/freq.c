@@ -0,0 +1,308 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <iso646.h>
+#include <pthread.h>
+#include "count.h"
+#include "freq.h"
+
+#define ARENA_CHUNK (1 << 20)
+#define TABLE_MIN 1024
+
+struct arena_chunk {
+	struct arena_chunk *next;
+	size_t used, size;
+	char data[];
+};
+
+struct freq_partition {
+	const char *data;
+	size_t start, end, len;
+	struct freq_table table;
+};
+
+/* space for len bytes at the top of the arena, kept only after arena_commit */
+static char *arena_reserve(struct freq_table *table, size_t len) {
+	struct arena_chunk *chunk = table->chunks;
+	if (chunk == NULL or chunk->size - chunk->used < len) {
+		size_t size = len > ARENA_CHUNK ? len : ARENA_CHUNK;
+		chunk = malloc(sizeof(struct arena_chunk) + size);
+		if (chunk == NULL)
+			return NULL;
+		chunk->next = table->chunks;
+		chunk->used = 0;
+		chunk->size = size;
+		table->chunks = chunk;
+	}
+	return chunk->data + chunk->used;
+}
+
+static void arena_commit(struct freq_table *table, size_t len) {
+	table->chunks->used += len;
+}
+
+static uint64_t hash_word(const char *word, size_t len) {
+	uint64_t h = 0x9e3779b97f4a7c15ULL ^ len, v;
+	size_t i = 0;
+	for (; i + 8 <= len; i += 8) {
+		memcpy(&v, word + i, 8);
+		h = (h ^ v) * 0xff51afd7ed558ccdULL;
+		h ^= h >> 32;
+	}
+	v = 0;
+	memcpy(&v, word + i, len - i);
+	h = (h ^ v) * 0xc4ceb9fe1a85ec53ULL;
+	return h ^ h >> 29;
+}
+
+static struct freq_entry *lookup(struct freq_table *table, uint64_t hash, const char *word, size_t len) {
+	size_t mask = table->capacity - 1;
+	for (size_t i = hash & mask;; i = (i + 1) & mask) {
+		struct freq_entry *entry = &table->entries[i];
+		if (entry->word == NULL or (entry->hash == hash and entry->len == len and
+				memcmp(entry->word, word, len) == 0))
+			return entry;
+	}
+}
+
+/* keeps the old entries when there is no memory for more, they still work, only fuller */
+static void grow(struct freq_table *table) {
+	struct freq_entry *old = table->entries;
+	size_t old_capacity = table->capacity;
+
+	table->entries = calloc(old_capacity * 2, sizeof(struct freq_entry));
+	if (table->entries == NULL) {
+		table->entries = old;
+		return;
+	}
+	table->capacity *= 2;
+	for (size_t i = 0; i < old_capacity; i++)
+		if (old[i].word != NULL)
+			*lookup(table, old[i].hash, old[i].word, old[i].len) = old[i];
+	free(old);
+}
+
+/* word must already be stored in the arena of table, a full table drops it and fails */
+static void insert(struct freq_table *table, uint64_t hash, const char *word, size_t len, unsigned long long count) {
+	struct freq_entry *entry = lookup(table, hash, word, len);
+	if (entry->word == NULL) {
+		/* one empty entry must stay for lookup to stop at */
+		if (table->count + 2 > table->capacity) {
+			table->failed = true;
+			return;
+		}
+		entry->hash = hash;
+		entry->word = word;
+		entry->len = len;
+		entry->count = 0;
+		table->count++;
+	}
+	entry->count += count;
+	if (table->count * 10 > table->capacity * 7)
+		grow(table);
+}
+
+/* simple case folding of ASCII, Latin-1, Greek and Cyrillic, none of them changes the length */
+static void fold_case(const unsigned char *src, size_t len, unsigned char *dst) {
+	for (size_t i = 0; i < len; i++) {
+		unsigned char c = src[i], n = i + 1 < len ? src[i + 1] : 0;
+		dst[i] = c >= 'A' and c <= 'Z' ? c + 'a' - 'A' : c;
+		if (c < 0xc3 or c > 0xd0 or (n & 0xc0) != 0x80)
+			continue;
+		if (c == 0xc3 and n <= 0x9e and n != 0x97)
+			n += 0x20;
+		else if (c == 0xce and n >= 0x91 and n <= 0x9f)
+			n += 0x20;
+		else if (c == 0xce and n >= 0xa0 and n <= 0xa9 and n != 0xa2)
+			c = 0xcf, n -= 0x20;
+		else if (c == 0xd0 and n >= 0x90 and n <= 0x9f)
+			n += 0x20;
+		else if (c == 0xd0 and n >= 0xa0 and n <= 0xaf)
+			c = 0xd1, n -= 0x20;
+		else if (c == 0xd0 and n <= 0x8f)
+			c = 0xd1, n += 0x10;
+		dst[i] = c;
+		dst[++i] = n;
+	}
+}
+
+/* a table without entries takes no words and is marked failed */
+void freq_init(struct freq_table *table, const struct freq_options *options) {
+	table->count = 0;
+	table->entries = calloc(TABLE_MIN, sizeof(struct freq_entry));
+	table->capacity = table->entries ? TABLE_MIN : 0;
+	table->chunks = NULL;
+	table->options = *options;
+	table->failed = table->entries == NULL;
+}
+
+void freq_free(struct freq_table *table) {
+	while (table->chunks != NULL) {
+		struct arena_chunk *next = table->chunks->next;
+		free(table->chunks);
+		table->chunks = next;
+	}
+	free(table->entries);
+	table->entries = NULL;
+}
+
+void freq_add(struct freq_table *table, const char *word, size_t len) {
+	const struct freq_options *options = &table->options;
+	struct freq_entry *entry;
+	char *key = NULL;
+	uint64_t hash;
+
+	if (table->capacity == 0)
+		return;
+	if (options->min_length > 1) {
+		size_t chars = 0;
+		for (size_t i = 0; i < len and chars < options->min_length; i++)
+			chars += ((unsigned char)word[i] & 0xc0) != 0x80;
+		if (chars < options->min_length)
+			return;
+	}
+	/* the folded key is written where it would be stored and kept only if the word is new */
+	if (options->fold_case) {
+		if ((key = arena_reserve(table, len)) == NULL) {
+			table->failed = true;
+			return;
+		}
+		fold_case((const unsigned char *)word, len, (unsigned char *)key);
+		word = key;
+	}
+
+	hash = hash_word(word, len);
+	entry = lookup(table, hash, word, len);
+	if (entry->word != NULL) {
+		entry->count++;
+		return;
+	}
+	if (not options->fold_case) {
+		if ((key = arena_reserve(table, len)) == NULL) {
+			table->failed = true;
+			return;
+		}
+		memcpy(key, word, len);
+	}
+	arena_commit(table, len);
+	insert(table, hash, key, len, 1);
+}
+
+/* adds the counts of from to into and takes over its arena, from is left empty */
+void freq_merge(struct freq_table *into, struct freq_table *from) {
+	struct arena_chunk **tail;
+
+	into->failed |= from->failed;
+	for (size_t i = 0; into->capacity > 0 and i < from->capacity; i++) {
+		struct freq_entry *entry = &from->entries[i];
+		if (entry->word != NULL)
+			insert(into, entry->hash, entry->word, entry->len, entry->count);
+	}
+	/* chunks go after the current one, which keeps taking new words */
+	tail = into->chunks ? &into->chunks->next : &into->chunks;
+	while (*tail != NULL)
+		tail = &(*tail)->next;
+	*tail = from->chunks;
+	from->chunks = NULL;
+	freq_free(from);
+}
+
+/*
+ * Adds the words starting in data[start..end) to the table, the last one may run on up to len.
+ * Bytes are classified like count_block does, so the words are the ones it counts; a word
+ * belongs to the range holding the byte that made it one and starts with that character.
+ * Unless eof is set, a word or character cut off by len is left for the next call:
+ * the return value is where it starts, or len when everything was consumed.
+ */
+size_t freq_scan(struct freq_table *table, const char *data, size_t start, size_t end, size_t len, bool eof) {
+	const unsigned char *p = (const unsigned char *)data;
+	bool unicode = table->options.unicode_spaces, space, skip = false;
+	struct count_state state = { false, false, 0 };
+	/* replayed from a byte that does not depend on the ones before it, words before start are skipped */
+	size_t i = count_fresh_start(data, start), word = i, character = i;
+
+	for (; i < len; i++) {
+		/* a byte that does not continue a pending character starts a new one */
+		if (state.utf8 == 0 or (p[i] & 0xc0) != 0x80)
+			character = i;
+		space = count_space(p[i], unicode, &state);
+		if (space and state.in_word) {
+			if (not skip)
+				freq_add(table, data + word, character - word);
+		}
+		else if (not space and not state.in_word) {
+			if (i >= end)
+				return len;
+			word = character;
+			skip = i < start;
+		}
+		if (space and i >= end)
+			return len;
+		state.in_word = not space;
+	}
+	if (not eof)
+		return state.in_word and not skip ? word : state.utf8 ? character : len;
+	if (state.in_word and not skip)
+		freq_add(table, data + word, len - word);
+	return len;
+}
+
+static void *freq_partition(void *arg) {
+	struct freq_partition *part = arg;
+	freq_scan(&part->table, part->data, part->start, part->end, part->len, true);
+	return NULL;
+}
+
+/* splits data into jobs ranges with a table per thread, merged in range order */
+void freq_parallel(const char *data, size_t len, int jobs, struct freq_table *table) {
+	if ((size_t)jobs > len)
+		jobs = len;
+	if (jobs < 2) {
+		freq_scan(table, data, 0, len, len, true);
+		return;
+	}
+
+	struct freq_partition parts[jobs];
+	pthread_t threads[jobs];
+	bool started[jobs];
+
+	for (int i = 1; i < jobs; i++) {
+		parts[i].data = data;
+		parts[i].start = len / jobs * i;
+		parts[i].end = i == jobs - 1 ? len : len / jobs * (i + 1);
+		parts[i].len = len;
+		freq_init(&parts[i].table, &table->options);
+		started[i] = pthread_create(&threads[i], NULL, freq_partition, &parts[i]) == 0;
+	}
+	freq_scan(table, data, 0, len / jobs, len, true);
+
+	for (int i = 1; i < jobs; i++) {
+		if (started[i])
+			pthread_join(threads[i], NULL);
+		else
+			freq_partition(&parts[i]);
+		freq_merge(table, &parts[i].table);
+	}
+}
+
+static int compare_entries(const void *a, const void *b) {
+	const struct freq_entry *x = a, *y = b;
+	int order;
+	if (x->count != y->count)
+		return x->count > y->count ? -1 : 1;
+	order = memcmp(x->word, y->word, x->len < y->len ? x->len : y->len);
+	return order != 0 ? order : (x->len > y->len) - (x->len < y->len);
+}
+
+/*
+ * Moves the words to the front of the entry array, most frequent first and
+ * equally frequent ones in byte order. The table can only be freed afterwards.
+ */
+size_t freq_sort(struct freq_table *table) {
+	size_t count = 0;
+	for (size_t i = 0; i < table->capacity; i++)
+		if (table->entries[i].word != NULL)
+			table->entries[count++] = table->entries[i];
+	qsort(table->entries, count, sizeof(struct freq_entry), compare_entries);
+	return count;
+}
@@ -0,0 +1,40 @@
+#ifndef FREQ_INCLUDED
+#define FREQ_INCLUDED
+
+#include <stddef.h>
+#include <stdbool.h>
+
+struct freq_options {
+	/* in characters, shorter words are not counted */
+	unsigned min_length;
+	bool fold_case;
+	bool unicode_spaces;
+};
+
+struct freq_entry {
+	unsigned long long hash, count;
+	const char *word;
+	size_t len;
+};
+
+struct arena_chunk;
+
+/* open addressing with linear probing, words live in arena chunks owned by the table */
+struct freq_table {
+	struct freq_entry *entries;
+	size_t capacity, count;
+	struct arena_chunk *chunks;
+	struct freq_options options;
+	/* set when words were dropped for lack of memory */
+	bool failed;
+};
+
+void freq_init(struct freq_table *table, const struct freq_options *options);
+void freq_free(struct freq_table *table);
+void freq_add(struct freq_table *table, const char *word, size_t len);
+void freq_merge(struct freq_table *into, struct freq_table *from);
+size_t freq_scan(struct freq_table *table, const char *data, size_t start, size_t end, size_t len, bool eof);
+void freq_parallel(const char *data, size_t len, int jobs, struct freq_table *table);
+size_t freq_sort(struct freq_table *table);
+
+#endif
@@ -1,33 +1,142 @@
 #!/bin/sh
 
 
-ANSWERS=(13 83 3 2 13 57 0 1 0 0 0 0 5 45 8 5)
-i=0
-for testfile in tests/test?.txt; do
-	words=$(../bin/wordcount -w $testfile)
-	bytes=$(../bin/wordcount -c $testfile)
-	lines=$(../bin/wordcount -l $testfile)
-	not_empty=$(../bin/wordcount -L $testfile)
-	if [[ $words -eq ${ANSWERS[$i]} && 
-		  $bytes -eq ${ANSWERS[$(($i + 1))]} &&
-		  $lines -eq ${ANSWERS[$(($i + 2))]} &&
-		  $not_empty -eq ${ANSWERS[$(($i + 3))]} ]]; then
-			echo -e "Test \e[33;1m$(($i / 4 + 1 )) \e[32mpassed\e[0m "
-	else 
-		echo -ne "Test \e[33;1m$(($i / 4 + 1)) \e[31mFAILED\E[0m ["
-			if [[ $words -ne ${ANSWERS[$i]} ]]; then
-				echo -ne "Words got: $words, Expected: ${ANSWERS[$i]}; "
-			fi
-			if [[ $bytes -ne ${ANSWERS[$(($i + 1))]} ]]; then
-				echo -ne "Bytes got: $bytes, Expected: ${ANSWERS[$(($i + 1))]}; "
-			fi
-			if [[ $lines -ne ${ANSWERS[$(($i + 2))]} ]]; then
-				echo -ne "Lines got: $lines, Expected: ${ANSWERS[$(($i + 2))]}; "
-			fi
-			if [[ $not_empty -ne ${ANSWERS[$(($i + 3))]} ]]; then
-				echo -ne "Not empty lines got: $not_empty, Expected: ${ANSWERS[$(($i + 3))]}; "
-			fi
-		echo -e "\b\b  \b\b]"
+ANSWERS=(13 83 3 2 13 57 0 1 0 0 0 0 5 45 8 5 60 714 93 44)
+# kernel:jobs pairs, more jobs than bytes in a line makes words cross partitions
+RUNS="avx2:1 sse2:1 swar:1 scalar:1 avx2:3 swar:7 scalar:64"
+for run in $RUNS; do
+	kernel=${run%:*}
+	jobs=${run#*:}
+	export WORDCOUNT_KERNEL=$kernel
+	i=0
+	for testfile in tests/test?.txt; do
+		words=$(../bin/wordcount -j $jobs -w $testfile)
+		bytes=$(../bin/wordcount -j $jobs -c $testfile)
+		lines=$(../bin/wordcount -j $jobs -l $testfile)
+		not_empty=$(../bin/wordcount -j $jobs -L $testfile)
+		if [[ $words -eq ${ANSWERS[$i]} && 
+			  $bytes -eq ${ANSWERS[$(($i + 1))]} &&
+			  $lines -eq ${ANSWERS[$(($i + 2))]} &&
+			  $not_empty -eq ${ANSWERS[$(($i + 3))]} ]]; then
+				echo -e "Test \e[33;1m$(($i / 4 + 1 )) ($kernel, $jobs jobs) \e[32mpassed\e[0m "
+		else 
+			echo -ne "Test \e[33;1m$(($i / 4 + 1)) ($kernel, $jobs jobs) \e[31mFAILED\E[0m ["
+				if [[ $words -ne ${ANSWERS[$i]} ]]; then
+					echo -ne "Words got: $words, Expected: ${ANSWERS[$i]}; "
+				fi
+				if [[ $bytes -ne ${ANSWERS[$(($i + 1))]} ]]; then
+					echo -ne "Bytes got: $bytes, Expected: ${ANSWERS[$(($i + 1))]}; "
+				fi
+				if [[ $lines -ne ${ANSWERS[$(($i + 2))]} ]]; then
+					echo -ne "Lines got: $lines, Expected: ${ANSWERS[$(($i + 2))]}; "
+				fi
+				if [[ $not_empty -ne ${ANSWERS[$(($i + 3))]} ]]; then
+					echo -ne "Not empty lines got: $not_empty, Expected: ${ANSWERS[$(($i + 3))]}; "
+				fi
+			echo -e "\b\b  \b\b]"
+		fi
+		i=$(($i + 4))
+	done
+done
+
+# all files at once plus test1 again through stdin, only the total row is checked
+expected=${ANSWERS[0]}
+for ((i = 0; i < ${#ANSWERS[@]}; i += 4)); do
+	expected=$(($expected + ${ANSWERS[$i]}))
+done
+read -r total name <<< "$(../bin/wordcount -j 3 -w - tests/test?.txt < tests/test1.txt | tail -n 1)"
+if [[ $total -eq $expected && $name == total ]]; then
+	echo -e "Test \e[33;1mtotal \e[32mpassed\e[0m "
+else
+	echo -e "Test \e[33;1mtotal \e[31mFAILED\e[0m [Words got: $total $name, Expected: $expected total]"
+fi
+
+# UTF-8 text: chars and words with ASCII-only and Unicode whitespace
+for run in $RUNS; do
+	export WORDCOUNT_KERNEL=${run%:*}
+	read -r words chars <<< "$(../bin/wordcount -j ${run#*:} -w -m tests/utf8.txt)"
+	read -r unicode_words <<< "$(../bin/wordcount -j ${run#*:} -u -w tests/utf8.txt)"
+	if [[ $words -eq 60 && $chars -eq 468 && $unicode_words -eq 84 ]]; then
+		echo -e "Test \e[33;1mutf8 ($WORDCOUNT_KERNEL, ${run#*:} jobs) \e[32mpassed\e[0m "
+	else
+		echo -e "Test \e[33;1mutf8 ($WORDCOUNT_KERNEL, ${run#*:} jobs) \e[31mFAILED\e[0m [Got: $words $chars $unicode_words, Expected: 60 468 84]"
+	fi
+done
+
+# files of 1 MiB and more are mapped and split between the jobs, reading them through a pipe must give the same
+big=$(mktemp)
+while [[ $(stat -c %s $big) -lt 1100000 ]]; do
+	cat tests/utf8.txt tests/test?.txt >> $big
+done
+streamed=$(cat $big | WORDCOUNT_KERNEL=scalar ../bin/wordcount -l -w -m -L -)
+for run in $RUNS; do
+	export WORDCOUNT_KERNEL=${run%:*}
+	mapped=$(../bin/wordcount -j ${run#*:} -l -w -m -L $big)
+	if [[ $mapped == "$streamed" ]]; then
+		echo -e "Test \e[33;1mlarge ($WORDCOUNT_KERNEL, ${run#*:} jobs) \e[32mpassed\e[0m "
+	else
+		echo -e "Test \e[33;1mlarge ($WORDCOUNT_KERNEL, ${run#*:} jobs) \e[31mFAILED\e[0m [Got: $mapped, Expected: $streamed]"
 	fi
-	i=$(($i + 4))
 done
+
+# runs of stray continuation bytes keep the class before them, a range starting inside one must see it
+invalid=$(mktemp)
+for i in {1..16}; do printf 'a\x80\x80\x80\x80\x80\x80\x80\x80\x80\x80\x80\x80\x80\x80\x80\x80\x80\x80\x80\x80b \n'; done > $invalid
+while [[ $(stat -c %s $invalid) -lt 1100000 ]]; do
+	cat $invalid $invalid > $invalid.tmp && mv $invalid.tmp $invalid
+done
+single=$(../bin/wordcount -j 1 -u -w $invalid)
+split=$(../bin/wordcount -j 64 -u -w $invalid)
+if [[ $split == "$single" ]]; then
+	echo -e "Test \e[33;1minvalid utf8 (64 jobs) \e[32mpassed\e[0m "
+else
+	echo -e "Test \e[33;1minvalid utf8 (64 jobs) \e[31mFAILED\e[0m [Got: $split, Expected: $single]"
+fi
+rm $invalid
+
+# resuming from the cache after an append must match a full count, a rewrite must be noticed
+temp=$(mktemp -d)
+cp tests/test5.txt $temp/log.txt
+../bin/wordcount -C $temp/cache -w -L $temp/log.txt > /dev/null
+cat tests/test1.txt >> $temp/log.txt
+appended=$(../bin/wordcount -C $temp/cache -w -L -m $temp/log.txt)
+printf 'rewritten' | dd of=$temp/log.txt conv=notrunc status=none
+rewritten=$(../bin/wordcount -C $temp/cache -w -L -m $temp/log.txt)
+# entries of removed files are dropped, a cache written without the version is refused
+cp tests/test1.txt $temp/gone.txt
+../bin/wordcount -C $temp/cache $temp/gone.txt > /dev/null
+rm $temp/gone.txt
+../bin/wordcount -C $temp/cache $temp/log.txt > /dev/null
+printf 'WCCACHE1\001\000\000\000\000\000\000\000' > $temp/old
+if [[ $appended == "46 73 787" && $rewritten == "$(../bin/wordcount -w -L -m $temp/log.txt)" ]] &&
+		grep -q log.txt $temp/cache && ! grep -q gone.txt $temp/cache &&
+		! ../bin/wordcount -C $temp/old $temp/log.txt > /dev/null 2>&1; then
+	echo -e "Test \e[33;1mcache \e[32mpassed\e[0m "
+else
+	echo -e "Test \e[33;1mcache \e[31mFAILED\e[0m [Got: $appended; $rewritten, Expected: 46 73 787, no entry of a removed file, old cache refused]"
+fi
+rm -r $temp
+
+# frequencies must add up to the word count, whichever way the file is split
+streamed=$(cat $big | ../bin/wordcount -u -f 1000000 -)
+for jobs in 1 3 7 64; do
+	sum=$(../bin/wordcount -j $jobs -u -f 1000 tests/utf8.txt tests/test5.txt | awk '{ sum += $1 } END { print sum }')
+	top=$(../bin/wordcount -j $jobs -u -i -f 1 tests/utf8.txt)
+	mapped=$(../bin/wordcount -j $jobs -u -f 1000000 $big)
+	if [[ $sum -eq 144 && $top == "6 space" && $mapped == "$streamed" ]]; then
+		echo -e "Test \e[33;1mfreq ($jobs jobs) \e[32mpassed\e[0m "
+	else
+		echo -e "Test \e[33;1mfreq ($jobs jobs) \e[31mFAILED\e[0m [Got: $sum, $top, Expected: 144, 6 space; large file differs: $([[ $mapped == "$streamed" ]] && echo no || echo yes)]"
+	fi
+done
+
+# malformed bytes are classified like the word count does, a stray continuation keeps the space before it
+malformed=' \x80\x80 x \xc2 y\xe2\x80\n'
+words=$(printf "$malformed" | ../bin/wordcount -u -w -)
+sum=$(printf "$malformed" | ../bin/wordcount -u -f 10 - | awk '{ sum += $1 } END { print sum }')
+if [[ $sum -eq $words ]]; then
+	echo -e "Test \e[33;1mfreq malformed \e[32mpassed\e[0m "
+else
+	echo -e "Test \e[33;1mfreq malformed \e[31mFAILED\e[0m [Got: $sum, Expected: $words]"
+fi
+rm $big
@@ -1,105 +1,401 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <iso646.h>
 #include <string.h>
-#include <ctype.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "count.h"
+#include "cache.h"
+#include "freq.h"
 
-const char USAGE_MESSAGE[] = "Usage: %s [-l, --lines | -L, --not-empty-lines | -c, --bytes | -w, --words] FILE\n";
+#define BUFFER_SIZE (1 << 20)
+/* files are split between threads only when every thread gets at least this much */
+#define PARTITION_MIN (8 << 20)
 
-const char *OPTIONS[4][2] = {
+const char USAGE_MESSAGE[] = "Usage: %s [-l, --lines] [-L, --not-empty-lines] [-c, --bytes] [-w, --words] [-m, --chars] [-u, --unicode-spaces] [-j, --jobs N] [-C, --cache FILE] [-f, --freq N [-i, --ignore-case] [-n, --min-length N]] [FILE]...\n";
+
+enum option { LINES, NOT_EMPTY_LINES, BYTES, WORDS, CHARS, UNICODE_SPACES, JOBS, CACHE, FREQ, IGNORE_CASE, MIN_LENGTH, OPTIONS_COUNT };
+
+const char *OPTIONS[OPTIONS_COUNT][2] = {
 	{"-l", "--lines"},
 	{"-L", "--not-empty-lines"},
 	{"-c", "--bytes"},
-	{"-w", "--words"}
+	{"-w", "--words"},
+	{"-m", "--chars"},
+	{"-u", "--unicode-spaces"},
+	{"-j", "--jobs"},
+	{"-C", "--cache"},
+	{"-f", "--freq"},
+	{"-i", "--ignore-case"},
+	{"-n", "--min-length"}
+};
+
+/* output order of the counters when several are requested */
+const int COLUMNS[] = { LINES, NOT_EMPTY_LINES, WORDS, CHARS, BYTES };
+#define COLUMNS_COUNT (int)(sizeof(COLUMNS) / sizeof(COLUMNS[0]))
+
+struct input {
+	char *name;
+	const char *error;
+	struct counts counts;
+	/* set when the result should be written back to the cache */
+	bool cached;
+	struct cache_entry entry;
+};
+
+struct pool {
+	struct input *inputs;
+	int count, next, jobs;
+	const struct cache *cache;
+	bool unicode_spaces;
+	/* one frequency table per worker in --freq mode, NULL otherwise */
+	struct freq_table *tables;
+	int workers;
 };
 
 int select_option(char *arg) {
-	for (int option = 0; option < 4; option++)
-		if (strcmp(OPTIONS[option][0], arg) == 0 or 
+	for (int option = 0; option < OPTIONS_COUNT; option++)
+		if (strcmp(OPTIONS[option][0], arg) == 0 or
 						strcmp(OPTIONS[option][1], arg) == 0)
 			return option;
 	return -1;
 }
 
-int count_lines(FILE *file) {
-	int c, lines = 0;
-	while ((c = fgetc(file)) != EOF) {
-		if (c == '\n')
-			lines++;
+/* reads the rest of the file in large blocks, counts and state continue from their current values */
+int count_stream(int fd, struct counts *counts, struct count_state *state) {
+	static _Thread_local char buffer[BUFFER_SIZE];
+	ssize_t read_bytes;
+
+	while ((read_bytes = read(fd, buffer, BUFFER_SIZE)) > 0)
+		count_block(buffer, read_bytes, counts, state);
+	return read_bytes < 0;
+}
+
+/*
+ * Counts the file from offset on, where counts and state were taken.
+ * Regular files are mapped and counted in parallel, jobs <= 0 picks the count by size.
+ */
+int count_file(int fd, int jobs, off_t offset, struct counts *counts, struct count_state *state) {
+	struct stat info;
+	char *data;
+
+	if (offset > 0 and lseek(fd, offset, SEEK_SET) != offset)
+		return 1;
+	/* small files are cheaper to read than to map */
+	if (fstat(fd, &info) != 0 or not S_ISREG(info.st_mode) or info.st_size - offset < BUFFER_SIZE)
+		return count_stream(fd, counts, state);
+
+	data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (data == MAP_FAILED)
+		return count_stream(fd, counts, state);
+	madvise(data + offset / BUFFER_SIZE * BUFFER_SIZE, info.st_size - offset / BUFFER_SIZE * BUFFER_SIZE,
+		MADV_SEQUENTIAL);
+
+	if (jobs <= 0) {
+		jobs = sysconf(_SC_NPROCESSORS_ONLN);
+		if (jobs > (info.st_size - offset) / PARTITION_MIN)
+			jobs = (info.st_size - offset) / PARTITION_MIN;
 	}
-	return lines;
+	count_parallel(data, offset, info.st_size, jobs, counts, state);
+	munmap(data, info.st_size);
+	return 0;
 }
 
-int count_not_empty_lines(FILE *file) {
-	int c, lines = 1, prev;
-	c = fgetc(file);
-	if (c == EOF)
+/* adds the words of the file to table, same strategy as count_file */
+int freq_file(int fd, int jobs, struct freq_table *table) {
+	static _Thread_local char buffer[BUFFER_SIZE];
+	struct stat info;
+	char *data;
+	size_t kept = 0, done;
+	ssize_t read_bytes;
+
+	if (fstat(fd, &info) == 0 and S_ISREG(info.st_mode) and info.st_size >= BUFFER_SIZE and
+			(data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0)) != MAP_FAILED) {
+		madvise(data, info.st_size, MADV_SEQUENTIAL);
+		if (jobs <= 0) {
+			jobs = sysconf(_SC_NPROCESSORS_ONLN);
+			if (jobs > info.st_size / PARTITION_MIN)
+				jobs = info.st_size / PARTITION_MIN;
+		}
+		freq_parallel(data, info.st_size, jobs, table);
+		munmap(data, info.st_size);
 		return 0;
-	while ((c = fgetc(file)) != EOF) {
-		if (prev == '\n' and c != '\n')
-			lines++;
-		prev = c;
 	}
-	return lines;
-}
 
-int count_bytes(FILE *file) {
-	int c, bytes = 0;
-	while ((c = fgetc(file)) != EOF) {
-		bytes++;
+	/* a word cut by the end of the buffer is moved to its start and finished with the next read */
+	while ((read_bytes = read(fd, buffer + kept, BUFFER_SIZE - kept)) > 0) {
+		kept += read_bytes;
+		done = freq_scan(table, buffer, 0, kept, kept, false);
+		if (done == 0 and kept == BUFFER_SIZE)
+			done = freq_scan(table, buffer, 0, kept, kept, true);
+		memmove(buffer, buffer + done, kept - done);
+		kept -= done;
 	}
-	return bytes;
+	freq_scan(table, buffer, 0, kept, kept, true);
+	return read_bytes < 0;
 }
 
-int count_words(FILE *file) {
-	int words = 0;
-	fscanf(file, " ");
+/*
+ * Resumes from the cached entry when the file has only grown since it was counted,
+ * otherwise counts from the start. Either way the new entry is kept in the input.
+ */
+int count_cached(int fd, int jobs, const struct pool *pool, struct input *input) {
+	const struct cache_entry *entry;
+	struct cache_entry *result = &input->entry;
+	struct count_state state;
+	struct stat info;
+	unsigned long long hash;
+
+	count_init(&input->counts, &state);
+	if (fstat(fd, &info) != 0 or not S_ISREG(info.st_mode))
+		return count_file(fd, jobs, 0, &input->counts, &state);
 
-	while (!feof(file)) {
-		words++;
-		fscanf(file, "%*s ");
+	entry = cache_find(pool->cache, info.st_dev, info.st_ino);
+	if (entry != NULL and entry->unicode_spaces == pool->unicode_spaces and
+			entry->size <= (unsigned long long)info.st_size and
+			cache_hash(fd, entry->size, &hash) == 0 and hash == entry->hash) {
+		input->counts = entry->counts;
+		state = entry->state;
 	}
-	
-	return words;
-}
 
-int main(int argc, char** argv) {
-	int result;
-	FILE *file;
-	
-	if (argc < 2) {
-		fprintf(stderr, USAGE_MESSAGE, argv[0]);
+	if (count_file(fd, jobs, input->counts.bytes, &input->counts, &state) != 0)
 		return 1;
+
+	memset(result, 0, sizeof *result);
+	result->dev = info.st_dev;
+	result->ino = info.st_ino;
+	result->size = input->counts.bytes;
+	result->unicode_spaces = pool->unicode_spaces;
+	result->counts = input->counts;
+	result->state = state;
+	input->cached = cache_hash(fd, result->size, &result->hash) == 0 and
+		(result->path = realpath(input->name, NULL)) != NULL;
+	return 0;
+}
+
+/* counts one input, "-" stands for the standard input */
+void count_input(struct input *input, const struct pool *pool, struct freq_table *table) {
+	int fd = strcmp(input->name, "-") == 0 ? STDIN_FILENO : open(input->name, O_RDONLY);
+	struct count_state state;
+	int failed;
+
+	input->error = NULL;
+	input->cached = false;
+	if (fd < 0) {
+		input->error = "Error opening file";
+		return;
 	}
-	
-	if (argc > 3) {
-		fprintf(stderr, "Too many arguments: %d\n", argc - 1);
-		fprintf(stderr, USAGE_MESSAGE, argv[0]);
-		return 1;
+	if (table != NULL) {
+		failed = freq_file(fd, pool->jobs, table);
+	}
+	else if (pool->cache != NULL and fd != STDIN_FILENO) {
+		failed = count_cached(fd, pool->jobs, pool, input);
+	}
+	else {
+		count_init(&input->counts, &state);
+		failed = count_file(fd, pool->jobs, 0, &input->counts, &state);
 	}
+	if (failed)
+		input->error = "Error reading file";
+	if (fd != STDIN_FILENO)
+		close(fd);
+}
 
-	file = fopen(argv[argc - 1], "r");
+/* workers take the next uncounted input until none are left, results stay in input order */
+void *count_worker(void *arg) {
+	struct pool *pool = arg;
+	int worker = __atomic_fetch_add(&pool->workers, 1, __ATOMIC_RELAXED), i;
+	struct freq_table *table = pool->tables ? &pool->tables[worker] : NULL;
 
-	if (!file) {
-		fprintf(stderr, "Error opening file '%s'\n", argv[argc - 1], file);
-		return 1;
+	while ((i = __atomic_fetch_add(&pool->next, 1, __ATOMIC_RELAXED)) < pool->count)
+		count_input(&pool->inputs[i], pool, table);
+	return NULL;
+}
+
+/* with freq set, words are collected into it instead of counting */
+void count_inputs(struct input *inputs, int count, int jobs, const struct cache *cache, bool unicode_spaces,
+		struct freq_table *freq) {
+	int workers = jobs > 0 ? jobs : sysconf(_SC_NPROCESSORS_ONLN);
+	if (workers > count)
+		workers = count;
+
+	/* with several workers each file is counted by one thread */
+	struct freq_table tables[workers];
+	struct pool pool = { inputs, count, 0, workers > 1 ? 1 : jobs, cache, unicode_spaces,
+		freq ? tables : NULL, 0 };
+	pthread_t threads[workers];
+	bool started[workers];
+
+	for (int i = 0; freq != NULL and i < workers; i++)
+		freq_init(&tables[i], &freq->options);
+	for (int i = 1; i < workers; i++)
+		started[i] = pthread_create(&threads[i], NULL, count_worker, &pool) == 0;
+	count_worker(&pool);
+	for (int i = 1; i < workers; i++)
+		if (started[i])
+			pthread_join(threads[i], NULL);
+	for (int i = 0; freq != NULL and i < workers; i++)
+		freq_merge(freq, &tables[i]);
+}
+
+void print_freq(struct freq_table *table, size_t top) {
+	size_t words = freq_sort(table);
+	int width = 0;
+
+	if (top > words)
+		top = words;
+	for (unsigned long long max = top ? table->entries[0].count : 0; max; max /= 10)
+		width++;
+	for (size_t i = 0; i < top; i++)
+		printf("%*llu %.*s\n", width, table->entries[i].count, (int)table->entries[i].len, table->entries[i].word);
+}
+
+unsigned long long select_count(const struct counts *counts, int option) {
+	switch (option) {
+		case LINES: return counts->lines;
+		case NOT_EMPTY_LINES: return counts->not_empty_lines;
+		case BYTES: return counts->bytes;
+		case CHARS: return counts->chars;
+		default: return counts->words;
 	}
+}
 
-	if (argv[1][0] == '-') {
-		switch(select_option(argv[1])) {
-			case 0: result = count_lines(file); break;
-			case 1: result = count_not_empty_lines(file); break;
-			case 2: result = count_bytes(file); break;
-			case 3: result = count_words(file); break;
-			default:
-				fprintf(stderr, "%s: invalid option '%s'\n", argv[0], argv[1]);
+void print_row(const struct counts *counts, bool show[], int width, const char *name) {
+	bool first = true;
+	for (int i = 0; i < COLUMNS_COUNT; i++) {
+		if (not show[COLUMNS[i]])
+			continue;
+		printf(first ? "%*llu" : " %*llu", width, select_count(counts, COLUMNS[i]));
+		first = false;
+	}
+	if (name != NULL)
+		printf(" %s", name);
+	putchar('\n');
+}
+
+int main(int argc, char** argv) {
+	struct input inputs[argc];
+	struct counts total;
+	struct count_state state;
+	struct cache cache;
+	struct freq_table freq;
+	struct freq_options freq_options = { 0, false, false };
+	bool show[OPTIONS_COUNT] = { false }, shown = false, unicode_spaces = false;
+	int jobs = 0, count = 0, width = 0, status = 0, top = 0;
+	char *cache_name = NULL;
+
+	for (int arg = 1; arg < argc; arg++) {
+		int option;
+		if (argv[arg][0] != '-' or argv[arg][1] == '\0') {
+			inputs[count++].name = argv[arg];
+			continue;
+		}
+		switch (option = select_option(argv[arg])) {
+			case JOBS:
+				if (arg + 1 >= argc or (jobs = atoi(argv[arg + 1])) <= 0) {
+					fprintf(stderr, "%s: '%s' expects a positive number\n", argv[0], argv[arg]);
+					return 1;
+				}
+				arg++;
+				break;
+			case FREQ:
+			case MIN_LENGTH:
+				if (arg + 1 >= argc or atoi(argv[arg + 1]) <= 0) {
+					fprintf(stderr, "%s: '%s' expects a positive number\n", argv[0], argv[arg]);
+					return 1;
+				}
+				if (option == FREQ)
+					top = atoi(argv[++arg]);
+				else
+					freq_options.min_length = atoi(argv[++arg]);
+				break;
+			case IGNORE_CASE:
+				freq_options.fold_case = true;
+				break;
+			case CACHE:
+				if (arg + 1 >= argc) {
+					fprintf(stderr, "%s: '%s' expects a file name\n", argv[0], argv[arg]);
+					return 1;
+				}
+				cache_name = argv[++arg];
+				break;
+			case UNICODE_SPACES:
+				count_unicode_spaces(unicode_spaces = true);
+				break;
+			case -1:
+				fprintf(stderr, "%s: invalid option '%s'\n", argv[0], argv[arg]);
 				fprintf(stderr, USAGE_MESSAGE, argv[0]);
 				return 1;
+			default:
+				show[option] = shown = true;
 		}
 	}
-	else {
-		result = count_words(file);
+
+	if (not shown)
+		show[WORDS] = true;
+	if (count == 0)
+		inputs[count++].name = "-";
+
+	/* the cache only keeps counts, it has nothing to offer to --freq */
+	if (top > 0)
+		cache_name = NULL;
+	if (cache_name != NULL and cache_load(cache_name, &cache) != 0) {
+		fprintf(stderr, "%s: '%s' is not a cache file\n", argv[0], cache_name);
+		cache_free(&cache);
+		return 1;
 	}
-	fclose(file);
-	printf("%d\n", result);
-	return 0;
+	freq_options.unicode_spaces = unicode_spaces;
+	if (top > 0)
+		freq_init(&freq, &freq_options);
+	count_inputs(inputs, count, jobs, cache_name ? &cache : NULL, unicode_spaces, top > 0 ? &freq : NULL);
+	if (cache_name != NULL) {
+		for (int i = 0; i < count; i++)
+			if (inputs[i].error == NULL and inputs[i].cached)
+				cache_put(&cache, &inputs[i].entry);
+		if (cache_save(cache_name, &cache) != 0) {
+			fprintf(stderr, "%s: Could not write cache '%s'\n", argv[0], cache_name);
+			status = 1;
+		}
+		cache_free(&cache);
+	}
+
+	if (top > 0) {
+		for (int i = 0; i < count; i++) {
+			if (inputs[i].error != NULL) {
+				fprintf(stderr, "%s '%s'\n", inputs[i].error, inputs[i].name);
+				status = 1;
+			}
+		}
+		if (freq.failed) {
+			fprintf(stderr, "%s: Out of memory, some words were not counted\n", argv[0]);
+			status = 1;
+		}
+		print_freq(&freq, top);
+		freq_free(&freq);
+		return status;
+	}
+
+	count_init(&total, &state);
+	for (int i = 0; i < count; i++)
+		if (inputs[i].error == NULL)
+			count_add(&total, &inputs[i].counts);
+	/* columns are aligned when several files are listed, like wc does */
+	if (count > 1)
+		for (unsigned long long max = total.bytes > total.words ? total.bytes : total.words; max; max /= 10)
+			width++;
+
+	for (int i = 0; i < count; i++) {
+		if (inputs[i].error != NULL) {
+			fprintf(stderr, "%s '%s'\n", inputs[i].error, inputs[i].name);
+			status = 1;
+			continue;
+		}
+		print_row(&inputs[i].counts, show, width, count > 1 ? inputs[i].name : NULL);
+	}
+	if (count > 1)
+		print_row(&total, show, width, "total");
+	return status;
 }
@@ -0,0 +1,77 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "uint256_t.h"
+#include "uint1024_t.h"
+#include "uint4096_t.h"
+
+/* ns per operation on full-width random operands, divisors are half as wide */
+
+#define OPERANDS 256
+/* every measurement runs for at least this long */
+#define MIN_TIME 0.05
+
+static volatile uint64_t sink;
+
+static double now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* runs body over all operands, doubling the rounds until it takes MIN_TIME */
+#define MEASURE(body) do { \
+	double start, elapsed; \
+	long rounds = 1; \
+	for (;;) { \
+		start = now(); \
+		for (long r = 0; r < rounds; r++) \
+			for (int i = 0; i < OPERANDS; i++) { \
+				const int j = (i + r) % OPERANDS; \
+				body; \
+			} \
+		if ((elapsed = now() - start) >= MIN_TIME) \
+			break; \
+		rounds *= 2; \
+	} \
+	printf(" %9.1f", elapsed * 1e9 / rounds / OPERANDS); \
+} while (0)
+
+#define DEFINE_BENCH(B) \
+static void bench_##B(void) { \
+	static uint##B##_t x[OPERANDS], y[OPERANDS], half[OPERANDS]; \
+	static char dec[OPERANDS][UINT##B##_DEC_SIZE]; \
+	\
+	for (int i = 0; i < OPERANDS; i++) { \
+		for (int k = 0; k < UINT##B##_LIMBS; k++) { \
+			x[i].limb[k] = (uint64_t)rand() << 42 ^ (uint64_t)rand() << 21 ^ rand(); \
+			y[i].limb[k] = (uint64_t)rand() << 42 ^ (uint64_t)rand() << 21 ^ rand(); \
+			half[i].limb[k] = k < UINT##B##_LIMBS / 2 ? y[i].limb[k] : 0; \
+		} \
+		uint##B##_to_dec(&x[i], dec[i], sizeof dec[i]); \
+	} \
+	\
+	printf("%8d", B); \
+	MEASURE(sink += uint##B##_add(&x[i], &y[j]).limb[0]); \
+	MEASURE(sink += uint##B##_substract(&x[i], &y[j]).limb[0]); \
+	MEASURE(sink += uint##B##_mult(&x[i], &y[j]).limb[0]); \
+	MEASURE(sink += uint##B##_mult_full(&x[i], &y[j]).high.limb[0]); \
+	MEASURE(sink += uint##B##_sqr(&x[j]).limb[0]); \
+	MEASURE(sink += uint##B##_divmod(&x[i], &half[j]).rem.limb[0]); \
+	MEASURE({ char buf[UINT##B##_DEC_SIZE]; sink += uint##B##_to_dec(&x[j], buf, sizeof buf); }); \
+	MEASURE(sink += uint##B##_scan(dec[j]).limb[0]); \
+	putchar('\n'); \
+}
+
+DEFINE_BENCH(256)
+DEFINE_BENCH(1024)
+DEFINE_BENCH(4096)
+
+int main(void) {
+	srand(1);
+	printf("%8s %9s %9s %9s %9s %9s %9s %9s %9s\n", "bits", "add", "sub", "mult", "mult_full", "sqr", "divmod", "to_dec", "scan");
+	bench_256();
+	bench_1024();
+	bench_4096();
+	return 0;
+}
@@ -0,0 +1,561 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <iso646.h>
+#include "uint256_t.h"
+#include "uint1024_t.h"
+#include "uint4096_t.h"
+
+/*
+ * Randomized differential tests: values below 2^128 are checked against unsigned __int128,
+ * any others against a slow reference over 32-bit words that shares no code with the library.
+ */
+
+#define MAX_WORDS (4096 / 32)
+
+typedef unsigned __int128 uint128_t;
+
+static uint64_t state = 0x9e3779b97f4a7c15ULL;
+static int failures;
+
+static uint64_t next(void) {
+	state ^= state >> 12;
+	state ^= state << 25;
+	state ^= state >> 27;
+	return state * 0x2545f4914f6cdd1dULL;
+}
+
+/* random length, and runs of ones or zeros now and then, which is where carries go wrong */
+static void random_limbs(uint64_t *limb, int n) {
+	int bits = next() % (64 * n + 1), kind = next() % 4;
+	for (int i = 0; i < n; i++) {
+		limb[i] = kind == 0 ? ~0ULL : kind == 1 ? 1ULL << next() % 64 : next();
+		if (64 * i >= bits)
+			limb[i] = 0;
+		else if (64 * i + 64 > bits)
+			limb[i] &= ~0ULL >> (64 * i + 64 - bits);
+	}
+}
+
+static void to_words(uint32_t *w, const uint64_t *limb, int n) {
+	for (int i = 0; i < n; i++) {
+		w[2 * i] = limb[i];
+		w[2 * i + 1] = limb[i] >> 32;
+	}
+}
+
+static void ref_add(uint32_t *r, const uint32_t *a, const uint32_t *b, int nw) {
+	uint64_t carry = 0;
+	for (int i = 0; i < nw; i++) {
+		carry += (uint64_t)a[i] + b[i];
+		r[i] = carry;
+		carry >>= 32;
+	}
+}
+
+static void ref_sub(uint32_t *r, const uint32_t *a, const uint32_t *b, int nw) {
+	int64_t borrow = 0;
+	for (int i = 0; i < nw; i++) {
+		int64_t t = (int64_t)a[i] - b[i] - borrow;
+		borrow = t < 0;
+		r[i] = t;
+	}
+}
+
+/* r[0..2 nw) = a b */
+static void ref_mul(uint32_t *r, const uint32_t *a, const uint32_t *b, int nw) {
+	memset(r, 0, 2 * nw * sizeof(uint32_t));
+	for (int i = 0; i < nw; i++) {
+		uint64_t carry = 0;
+		for (int j = 0; j < nw; j++) {
+			carry += (uint64_t)a[i] * b[j] + r[i + j];
+			r[i + j] = carry;
+			carry >>= 32;
+		}
+		r[i + nw] = carry;
+	}
+}
+
+static int ref_compare(const uint32_t *a, const uint32_t *b, int nw) {
+	for (int i = nw - 1; i >= 0; i--)
+		if (a[i] != b[i])
+			return a[i] > b[i] ? 1 : -1;
+	return 0;
+}
+
+static bool ref_is_zero(const uint32_t *a, int nw) {
+	for (int i = 0; i < nw; i++)
+		if (a[i])
+			return false;
+	return true;
+}
+
+/* restoring division one bit at a time from the top set bit, the divisor is not zero */
+static void ref_divmod(uint32_t *q, uint32_t *r, const uint32_t *a, const uint32_t *d, int nw) {
+	int top = 32 * nw - 1;
+	memset(q, 0, nw * sizeof(uint32_t));
+	memset(r, 0, nw * sizeof(uint32_t));
+	while (top >= 0 and not (a[top / 32] >> top % 32 & 1))
+		top--;
+	for (int bit = top; bit >= 0; bit--) {
+		uint32_t top = r[nw - 1] >> 31;
+		for (int i = nw - 1; i > 0; i--)
+			r[i] = r[i] << 1 | r[i - 1] >> 31;
+		r[0] = r[0] << 1 | (a[bit / 32] >> bit % 32 & 1);
+		if (top or ref_compare(r, d, nw) >= 0) {
+			ref_sub(r, r, d, nw);
+			q[bit / 32] |= 1U << bit % 32;
+		}
+	}
+}
+
+/* a b mod m through the full product */
+static void ref_modmul(uint32_t *r, const uint32_t *a, const uint32_t *b, const uint32_t *m, int nw) {
+	uint32_t product[2 * MAX_WORDS], wide[2 * MAX_WORDS], q[2 * MAX_WORDS], rem[2 * MAX_WORDS];
+	ref_mul(product, a, b, nw);
+	memcpy(wide, m, nw * sizeof(uint32_t));
+	memset(wide + nw, 0, nw * sizeof(uint32_t));
+	ref_divmod(q, rem, product, wide, 2 * nw);
+	memcpy(r, rem, nw * sizeof(uint32_t));
+}
+
+static void ref_shift_right(uint32_t *a, int nw) {
+	for (int i = 0; i < nw - 1; i++)
+		a[i] = a[i] >> 1 | a[i + 1] << 31;
+	a[nw - 1] >>= 1;
+}
+
+/* Stein's algorithm one bit at a time */
+static void ref_gcd(uint32_t *g, const uint32_t *a, const uint32_t *b, int nw) {
+	uint32_t u[MAX_WORDS], v[MAX_WORDS], t[MAX_WORDS];
+	int shift = 0;
+
+	memcpy(u, a, nw * sizeof(uint32_t));
+	memcpy(v, b, nw * sizeof(uint32_t));
+	if (ref_is_zero(u, nw) or ref_is_zero(v, nw)) {
+		memcpy(g, ref_is_zero(u, nw) ? v : u, nw * sizeof(uint32_t));
+		return;
+	}
+	for (; not ((u[0] | v[0]) & 1); shift++) {
+		ref_shift_right(u, nw);
+		ref_shift_right(v, nw);
+	}
+	while (not (u[0] & 1))
+		ref_shift_right(u, nw);
+	do {
+		while (not (v[0] & 1))
+			ref_shift_right(v, nw);
+		if (ref_compare(u, v, nw) > 0) {
+			memcpy(t, u, sizeof t);
+			memcpy(u, v, sizeof t);
+			memcpy(v, t, sizeof t);
+		}
+		ref_sub(v, v, u, nw);
+	} while (not ref_is_zero(v, nw));
+	for (; shift > 0; shift--)
+		ref_add(u, u, u, nw);
+	memcpy(g, u, nw * sizeof(uint32_t));
+}
+
+static void ref_to_hex(char *out, const uint32_t *a, int nw) {
+	char *cursor = out;
+	for (int i = nw - 1; i >= 0; i--)
+		cursor += sprintf(cursor, "%08x", a[i]);
+	cursor = out;
+	while (cursor[0] == '0' and cursor[1])
+		cursor++;
+	memmove(out, cursor, strlen(cursor) + 1);
+}
+
+static void ref_to_dec(char *out, const uint32_t *a, int nw) {
+	uint32_t t[MAX_WORDS];
+	char digits[MAX_WORDS * 10 + 1];
+	int count = 0, any;
+
+	memcpy(t, a, nw * sizeof(uint32_t));
+	do {
+		uint64_t rem = 0;
+		any = 0;
+		for (int i = nw - 1; i >= 0; i--) {
+			rem = rem << 32 | t[i];
+			t[i] = rem / 10;
+			rem %= 10;
+			any |= t[i];
+		}
+		digits[count++] = '0' + rem;
+	} while (any);
+	for (int i = 0; i < count; i++)
+		out[i] = digits[count - 1 - i];
+	out[count] = '\0';
+}
+
+static void fail(const char *width, const char *op, const uint64_t *x, const uint64_t *y, int n) {
+	if (failures++ >= 10)
+		return;
+	printf("%s %s failed for x =", width, op);
+	for (int i = n - 1; i >= 0; i--)
+		printf(" %016llx", (unsigned long long)x[i]);
+	printf("\n%*s y =", (int)(strlen(width) + strlen(op) + 12), "");
+	for (int i = n - 1; i >= 0; i--)
+		printf(" %016llx", (unsigned long long)y[i]);
+	putchar('\n');
+}
+
+#define CHECK(width, op, ok) do { if (not (ok)) fail(width, op, x.limb, y.limb, n); } while (0)
+
+/* one round per width: the same operand pair through every operation */
+#define DEFINE_ROUND(B) \
+static void round_##B(void) { \
+	enum { n = UINT##B##_LIMBS, nw = 2 * n }; \
+	uint##B##_t x, y, r; \
+	uint32_t a[nw], b[nw], expected[2 * nw], got[2 * nw], q[nw], rem[nw]; \
+	char dec[UINT##B##_DEC_SIZE], ref[UINT##B##_DEC_SIZE]; \
+	\
+	random_limbs(x.limb, n); \
+	random_limbs(y.limb, n); \
+	to_words(a, x.limb, n); \
+	to_words(b, y.limb, n); \
+	\
+	r = uint##B##_add(&x, &y); \
+	ref_add(expected, a, b, nw); \
+	to_words(got, r.limb, n); \
+	CHECK(#B, "add", memcmp(got, expected, nw * 4) == 0); \
+	r = uint##B##_substract(&x, &y); \
+	ref_sub(expected, a, b, nw); \
+	to_words(got, r.limb, n); \
+	CHECK(#B, "substract", memcmp(got, expected, nw * 4) == 0); \
+	\
+	uint##B##_wide w = uint##B##_mult_full(&x, &y); \
+	ref_mul(expected, a, b, nw); \
+	to_words(got, w.low.limb, n); \
+	to_words(got + nw, w.high.limb, n); \
+	CHECK(#B, "mult_full", memcmp(got, expected, 2 * nw * 4) == 0); \
+	r = uint##B##_mult(&x, &y); \
+	to_words(got, r.limb, n); \
+	CHECK(#B, "mult", memcmp(got, expected, nw * 4) == 0); \
+	r = uint##B##_sqr(&x); \
+	ref_mul(expected, a, a, nw); \
+	to_words(got, r.limb, n); \
+	CHECK(#B, "sqr", memcmp(got, expected, nw * 4) == 0); \
+	\
+	if (not uint##B##_is_zero(&y)) { \
+		uint##B##_div d = uint##B##_divmod(&x, &y); \
+		ref_divmod(q, rem, a, b, nw); \
+		to_words(got, d.quot.limb, n); \
+		to_words(got + nw, d.rem.limb, n); \
+		CHECK(#B, "divmod", memcmp(got, q, nw * 4) == 0 and memcmp(got + nw, rem, nw * 4) == 0); \
+	} \
+	\
+	uint##B##_to_dec(&x, dec, sizeof dec); \
+	ref_to_dec(ref, a, nw); \
+	CHECK(#B, "to_dec", strcmp(dec, ref) == 0); \
+	r = uint##B##_scan(dec); \
+	CHECK(#B, "scan", uint##B##_compare(&r, &x) == 0); \
+	uint##B##_to_hex(&x, dec, sizeof dec); \
+	ref_to_hex(ref, a, nw); \
+	CHECK(#B, "to_hex", strcmp(dec, ref) == 0); \
+	r = uint##B##_scan_hex(dec); \
+	CHECK(#B, "scan_hex", uint##B##_compare(&r, &x) == 0); \
+	\
+	/* a base about as long as the power needs to overflow half of the time, the flag is sticky since x^k grows */ \
+	uint64_t exponent = next() % 40; \
+	random_limbs(x.limb, n); \
+	for (int i = 0; exponent > 1 and i < n; i++) \
+		x.limb[i] = (uint64_t)(64 * i) < 2 * 64 * n / exponent ? x.limb[i] : 0; \
+	to_words(a, x.limb, n); \
+	y = uint##B##_from_uint(exponent); \
+	bool overflow = false; \
+	memset(rem, 0, sizeof rem); \
+	rem[0] = 1; \
+	for (uint64_t k = 0; k < exponent; k++) { \
+		ref_mul(expected, rem, a, nw); \
+		overflow |= not ref_is_zero(expected + nw, nw); \
+		memcpy(rem, expected, sizeof rem); \
+	} \
+	r = uint##B##_pow(&x, exponent); \
+	to_words(got, r.limb, n); \
+	CHECK(#B, "pow", memcmp(got, rem, nw * 4) == 0); \
+	CHECK(#B, "lpow", uint##B##_lpow(&x, exponent) == overflow and uint##B##_compare(&x, &r) == 0); \
+}
+
+/* modular operations, the reference reduces with the bitwise division and is run less often */
+#define DEFINE_MOD_ROUND(B) \
+static void mod_round_##B(void) { \
+	enum { n = UINT##B##_LIMBS, nw = 2 * n }; \
+	uint##B##_t x, y, z, r; \
+	uint##B##_mont ctx; \
+	uint32_t a[nw], b[nw], c[nw], expected[nw], got[nw], step[nw], one[nw]; \
+	\
+	random_limbs(x.limb, n); \
+	random_limbs(y.limb, n); \
+	random_limbs(z.limb, n); \
+	y.limb[0] |= 1; \
+	to_words(a, x.limb, n); \
+	to_words(b, y.limb, n); \
+	to_words(c, z.limb, n); \
+	memset(one, 0, sizeof one); \
+	one[0] = 1; \
+	\
+	CHECK(#B, "mont_init", uint##B##_mont_init(&ctx, &y)); \
+	r = uint##B##_modmul(&ctx, &x, &z); \
+	ref_modmul(expected, a, c, b, nw); \
+	to_words(got, r.limb, n); \
+	CHECK(#B, "modmul", memcmp(got, expected, nw * 4) == 0); \
+	/* exponents of up to 8 bits, long ones are checked against __int128 */ \
+	uint64_t exponent = next() % 256; \
+	uint##B##_t e = uint##B##_from_uint(exponent); \
+	r = uint##B##_modpow(&ctx, &x, &e); \
+	ref_modmul(expected, one, one, b, nw); \
+	for (int bit = 7; bit >= 0; bit--) { \
+		ref_modmul(step, expected, expected, b, nw); \
+		if (exponent >> bit & 1) \
+			ref_modmul(expected, step, a, b, nw); \
+		else \
+			memcpy(expected, step, sizeof step); \
+	} \
+	to_words(got, r.limb, n); \
+	CHECK(#B, "modpow", memcmp(got, expected, nw * 4) == 0); \
+	y.limb[0] &= ~1ULL; \
+	CHECK(#B, "mont_init", not uint##B##_mont_init(&ctx, &y)); \
+	\
+	/* gcd and lcm of two multiples of a common factor, each short enough for the product to fit */ \
+	for (int i = 0; i < n; i++) { \
+		x.limb[i] = i < n / 2 ? x.limb[i] : 0; \
+		y.limb[i] = i < n / 2 ? y.limb[i] : 0; \
+		z.limb[i] = i < n / 4 ? z.limb[i] : 0; \
+	} \
+	x = uint##B##_mult(&x, &z); \
+	y = uint##B##_mult(&y, &z); \
+	to_words(a, x.limb, n); \
+	to_words(b, y.limb, n); \
+	r = uint##B##_gcd(&x, &y); \
+	ref_gcd(expected, a, b, nw); \
+	to_words(got, r.limb, n); \
+	CHECK(#B, "gcd", memcmp(got, expected, nw * 4) == 0); \
+	r = uint##B##_lcm(&x, &y); \
+	if (not ref_is_zero(expected, nw)) { \
+		uint32_t q[nw], wide[2 * nw]; \
+		ref_divmod(q, step, a, expected, nw); \
+		ref_mul(wide, q, b, nw); \
+		memcpy(expected, wide, sizeof expected); \
+	} \
+	to_words(got, r.limb, n); \
+	CHECK(#B, "lcm", memcmp(got, expected, nw * 4) == 0); \
+	\
+	/* an inverse modulo an odd or even m times a is 1, no inverse means a common factor */ \
+	random_limbs(x.limb, n); \
+	random_limbs(y.limb, n); \
+	to_words(a, x.limb, n); \
+	to_words(b, y.limb, n); \
+	if (uint##B##_modinv(&r, &x, &y)) { \
+		to_words(c, r.limb, n); \
+		ref_modmul(expected, a, c, b, nw); \
+		ref_modmul(step, one, one, b, nw); \
+		CHECK(#B, "modinv", ref_compare(c, b, nw) < 0 and memcmp(expected, step, nw * 4) == 0); \
+	} \
+	else { \
+		ref_gcd(expected, a, b, nw); \
+		CHECK(#B, "modinv", ref_is_zero(b, nw) or memcmp(expected, one, nw * 4) != 0); \
+	} \
+}
+
+/* batches cross the block size now and then, and add in place into one of the operands */
+#define DEFINE_BATCH_ROUND(B) \
+static void batch_round_##B(void) { \
+	enum { n = UINT##B##_LIMBS, nw = 2 * n }; \
+	size_t count = 1 + next() % 300; \
+	uint##B##_batch xs, ys, out; \
+	uint##B##_t x, y, r; \
+	uint32_t a[nw], b[nw], expected[2 * nw], got[nw]; \
+	\
+	if (not uint##B##_batch_alloc(&xs, count) or not uint##B##_batch_alloc(&ys, count) \
+			or not uint##B##_batch_alloc(&out, count)) { \
+		printf("%s batch_alloc failed\n", #B); \
+		exit(1); \
+	} \
+	for (size_t k = 0; k < count; k++) { \
+		random_limbs(x.limb, n); \
+		random_limbs(y.limb, n); \
+		uint##B##_batch_set(&xs, k, &x); \
+		uint##B##_batch_set(&ys, k, &y); \
+	} \
+	uint##B##_mul_n(&out, &xs, &ys, count); \
+	for (size_t k = 0; k < count; k++) { \
+		x = uint##B##_batch_get(&xs, k); \
+		y = uint##B##_batch_get(&ys, k); \
+		r = uint##B##_batch_get(&out, k); \
+		to_words(a, x.limb, n); \
+		to_words(b, y.limb, n); \
+		ref_mul(expected, a, b, nw); \
+		to_words(got, r.limb, n); \
+		CHECK(#B, "mul_n", memcmp(got, expected, nw * 4) == 0); \
+	} \
+	uint##B##_sub_n(&out, &xs, &ys, count); \
+	for (size_t k = 0; k < count; k++) { \
+		x = uint##B##_batch_get(&xs, k); \
+		y = uint##B##_batch_get(&ys, k); \
+		r = uint##B##_batch_get(&out, k); \
+		to_words(a, x.limb, n); \
+		to_words(b, y.limb, n); \
+		ref_sub(expected, a, b, nw); \
+		to_words(got, r.limb, n); \
+		CHECK(#B, "sub_n", memcmp(got, expected, nw * 4) == 0); \
+	} \
+	/* out now holds x - y, which gives back the x that add_n overwrote */ \
+	uint##B##_add_n(&xs, &xs, &ys, count); \
+	for (size_t k = 0; k < count; k++) { \
+		x = uint##B##_batch_get(&out, k); \
+		y = uint##B##_batch_get(&ys, k); \
+		r = uint##B##_batch_get(&xs, k); \
+		to_words(a, x.limb, n); \
+		to_words(b, y.limb, n); \
+		ref_add(expected, a, b, nw); \
+		ref_add(expected, expected, b, nw); \
+		to_words(got, r.limb, n); \
+		CHECK(#B, "add_n", memcmp(got, expected, nw * 4) == 0); \
+	} \
+	uint##B##_batch_free(&xs); \
+	uint##B##_batch_free(&ys); \
+	uint##B##_batch_free(&out); \
+}
+
+DEFINE_ROUND(256)
+DEFINE_ROUND(1024)
+DEFINE_ROUND(4096)
+DEFINE_MOD_ROUND(256)
+DEFINE_MOD_ROUND(1024)
+DEFINE_MOD_ROUND(4096)
+DEFINE_BATCH_ROUND(256)
+DEFINE_BATCH_ROUND(1024)
+DEFINE_BATCH_ROUND(4096)
+
+static void u128_to_dec(char *out, uint128_t x) {
+	char digits[40];
+	int count = 0;
+	do {
+		digits[count++] = '0' + x % 10;
+		x /= 10;
+	} while (x);
+	for (int i = 0; i < count; i++)
+		out[i] = digits[count - 1 - i];
+	out[count] = '\0';
+}
+
+static uint64_t gcd_u64(uint64_t a, uint64_t b) {
+	while (b) {
+		uint64_t t = a % b;
+		a = b;
+		b = t;
+	}
+	return a;
+}
+
+static uint1024_t from_u128(uint128_t x) {
+	uint1024_t value = { { (uint64_t)x, (uint64_t)(x >> 64) } };
+	return value;
+}
+
+static bool equals_u128(const uint1024_t *x, uint128_t y) {
+	uint1024_t expected = from_u128(y);
+	return compare(x, &expected) == 0;
+}
+
+/* operands below 2^127 so that sums and, for 64-bit halves, products fit the native type */
+static void round_small(void) {
+	enum { n = UINT1024_LIMBS };
+	uint128_t u = ((uint128_t)next() << 64 | next()) >> next() % 128 >> 1;
+	uint128_t v = ((uint128_t)next() << 64 | next()) >> next() % 128 >> 1;
+	uint1024_t x = from_u128(u), y = from_u128(v), r;
+	char dec[UINT1024_DEC_SIZE], ref[40];
+
+	r = add(&x, &y);
+	CHECK("small", "add", equals_u128(&r, u + v));
+	r = u >= v ? substract(&x, &y) : substract(&y, &x);
+	CHECK("small", "substract", equals_u128(&r, u >= v ? u - v : v - u));
+	uint1024_t xl = from_u128((uint64_t)u), yl = from_u128((uint64_t)v);
+	r = mult(&xl, &yl);
+	CHECK("small", "mult", equals_u128(&r, (uint128_t)(uint64_t)u * (uint64_t)v));
+	if (v) {
+		uint1024_div d = divmod(&x, &y);
+		CHECK("small", "divmod", equals_u128(&d.quot, u / v) and equals_u128(&d.rem, u % v));
+	}
+	uint1024_to_dec(&x, dec, sizeof dec);
+	u128_to_dec(ref, u);
+	CHECK("small", "to_dec", strcmp(dec, ref) == 0);
+
+	uint128_t g = u, h = v, l;
+	while (h) {
+		uint128_t t = g % h;
+		g = h;
+		h = t;
+	}
+	r = gcd(&x, &y);
+	CHECK("small", "gcd", equals_u128(&r, g));
+	/* the lcm of 64-bit halves fits */
+	l = (uint64_t)u and (uint64_t)v ? (uint64_t)u / gcd_u64(u, v) * (uint128_t)(uint64_t)v : 0;
+	r = lcm(&xl, &yl);
+	CHECK("small", "lcm", equals_u128(&r, l));
+
+	/* a 64-bit modulus and an exponent as long as the type, which takes every window size */
+	uint64_t m = (uint64_t)v | 1, base = u % m, power = 1 % m;
+	uint1024_t modulus = from_u128(m), exponent;
+	uint1024_mont ctx;
+	random_limbs(exponent.limb, n);
+	uint1024_mont_init(&ctx, &modulus);
+	r = modmul(&ctx, &x, &y);
+	CHECK("small", "modmul", equals_u128(&r, (uint128_t)(u % m) * (v % m) % m));
+	for (int bit = 64 * n - 1; bit >= 0; bit--) {
+		power = (uint128_t)power * power % m;
+		if (exponent.limb[bit / 64] >> bit % 64 & 1)
+			power = (uint128_t)power * base % m;
+	}
+	r = modpow(&ctx, &x, &exponent);
+	CHECK("small", "modpow", equals_u128(&r, power));
+
+	/* extended Euclid on signed coefficients, the inverse exists when the gcd is 1 */
+	m = (uint64_t)v;
+	__int128 r0 = m, r1 = (uint64_t)u % (m ? m : 1), t0 = 0, t1 = 1;
+	while (r1) {
+		__int128 q = r0 / r1, t;
+		t = r0 - q * r1, r0 = r1, r1 = t;
+		t = t0 - q * t1, t0 = t1, t1 = t;
+	}
+	r = from_u128(0);
+	bool invertible = modinv(&r, &xl, &yl);
+	if (m == 0 or r0 != 1)
+		CHECK("small", "modinv", not invertible);
+	else
+		CHECK("small", "modinv", invertible and equals_u128(&r, t0 < 0 ? t0 + m : t0 % m));
+}
+
+int main(int argc, char **argv) {
+	long rounds = argc > 1 ? atol(argv[1]) : 20000;
+
+	if (argc > 2)
+		state = strtoull(argv[2], NULL, 0) | 1;
+	for (long i = 0; i < rounds; i++) {
+		round_small();
+		round_256();
+		round_1024();
+		/* the reference division is quadratic in bits, the widest type gets fewer rounds */
+		if (i % 16 == 0)
+			round_4096();
+		/* modular references reduce double-width products bit by bit */
+		mod_round_256();
+		if (i % 16 == 0)
+			mod_round_1024();
+		if (i % 256 == 0)
+			mod_round_4096();
+		if (i % 64 == 0) {
+			batch_round_256();
+			batch_round_1024();
+			batch_round_4096();
+		}
+	}
+	if (failures) {
+		printf("%d failures\n", failures);
+		return 1;
+	}
+	printf("%ld rounds passed\n", rounds);
+	return 0;
+}
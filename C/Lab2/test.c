@@ -1,12 +1,33 @@
 #include <stdio.h>
 #include <ctype.h>
 #include <stdlib.h>
+#include <iso646.h>
 #include "uint1024_t.h"
 
 int main(int argc, char **argv) {
-	uint1024_t *x = scan_uint1024(argv[1]);
-	//uint1024_t *y = uint1024_from_uint(atoi(argv[2]));
-	//uint1024_div d = divmod(x, y);
-	printf("%s\n", to_str(x));
+	if (argc < 3) {
+		fprintf(stderr, "Usage: %s X Y [M]\n", argv[0]);
+		return 1;
+	}
+	uint1024_t x = scan_uint1024(argv[1]), y = scan_uint1024(argv[2]);
+	uint1024_t sum = add(&x, &y), diff = substract(&x, &y), product = mult(&x, &y);
+	uint1024_div d = divmod(&x, &y);
+	printf_uint1024("x + y = %s\n", &sum);
+	printf_uint1024("x - y = %s\n", &diff);
+	printf_uint1024("x * y = %s\n", &product);
+	printf_uint1024("x / y = %s\n", &d.quot);
+	printf_uint1024("x %% y = %s\n", &d.rem);
+	if (argc > 3) {
+		uint1024_t m = scan_uint1024(argv[3]), product, power;
+		uint1024_mont ctx;
+		if (not uint1024_mont_init(&ctx, &m)) {
+			fprintf(stderr, "M must be odd\n");
+			return 1;
+		}
+		product = modmul(&ctx, &x, &y);
+		power = modpow(&ctx, &x, &y);
+		printf_uint1024("x * y mod m = %s\n", &product);
+		printf_uint1024("x ^ y mod m = %s\n", &power);
+	}
 	return 0;
 }
@@ -0,0 +1,87 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <iso646.h>
+#include <time.h>
+#include "uint4096_t.h"
+
+#define OPERANDS 64
+#define NEVER (2 * UINT4096_LIMBS + 1)
+
+static uint4096_t operands[UINT4096_LIMBS][OPERANDS];
+
+static double now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/*
+ * ns per full product of two n-limb operands, the best of five runs.
+ * The widest type covers every length, the thresholds are shared by all widths.
+ */
+static double measure(int n) {
+	int rounds = 1024000 / (n * n) < 4000 ? 1024000 / (n * n) + 1 : 4000;
+	double best = 1e30;
+	volatile uint64_t sink = 0;
+	for (int run = 0; run < 5; run++) {
+		double start = now(), t;
+		for (int r = 0; r < rounds; r++)
+			for (int i = 0; i < OPERANDS; i++)
+				sink += uint4096_mult_full(&operands[n - 1][i], &operands[n - 1][(i + r) % OPERANDS]).high.limb[0];
+		if ((t = (now() - start) * 1e9 / rounds / OPERANDS) < best)
+			best = t;
+	}
+	return best;
+}
+
+/* the threshold t that minimizes the time of slow[n] below t plus fast[n] from t on */
+static int crossover(const double *slow, const double *fast, int from, int to, int step) {
+	int best = to + 1;
+	double best_total = 1e30;
+	for (int t = from; t <= to + 1; t += step) {
+		double total = 0;
+		for (int n = from; n <= to; n += step)
+			total += n < t ? slow[n] : fast[n];
+		if (total < best_total)
+			best_total = total, best = t;
+	}
+	return best;
+}
+
+/*
+ * Prints the thresholds for this machine: each one is the length that minimizes
+ * the total time over all lengths, which a single noisy length cannot move far.
+ * Karatsuba is measured one level deep on top of the chosen Comba threshold.
+ */
+int main(void) {
+	double slow[UINT4096_LIMBS + 1], fast[UINT4096_LIMBS + 1];
+	int comba, karatsuba;
+
+	srand(1);
+	for (int n = 1; n <= UINT4096_LIMBS; n++)
+		for (int i = 0; i < OPERANDS; i++)
+			for (int j = 0; j < n; j++)
+				operands[n - 1][i].limb[j] = (uint64_t)rand() << 42 ^ (uint64_t)rand() << 21 ^ rand();
+
+	uint4096_karatsuba_threshold = NEVER;
+	for (int n = 1; n <= UINT4096_LIMBS; n++) {
+		uint4096_comba_threshold = NEVER;
+		slow[n] = measure(n);
+		uint4096_comba_threshold = 1;
+		fast[n] = measure(n);
+		printf("%3d limbs: schoolbook %8.1f ns, comba %8.1f ns\n", n, slow[n], fast[n]);
+	}
+	uint4096_comba_threshold = comba = crossover(slow, fast, 1, UINT4096_LIMBS, 1);
+
+	for (int n = 2; n <= UINT4096_LIMBS; n += 2) {
+		uint4096_karatsuba_threshold = NEVER;
+		slow[n] = measure(n);
+		uint4096_karatsuba_threshold = n;
+		fast[n] = measure(n);
+		printf("%3d limbs: comba %8.1f ns, karatsuba %8.1f ns\n", n, slow[n], fast[n]);
+	}
+	karatsuba = crossover(slow, fast, 2, UINT4096_LIMBS, 2);
+
+	printf("CFLAGS += -DCOMBA_THRESHOLD=%d -DKARATSUBA_THRESHOLD=%d\n", comba, karatsuba);
+	return 0;
+}
@@ -1,40 +1,43 @@
-#include <stdint.h>
-#define UINT1024_MIN_SIZE 32
-#define BASE 100
-typedef struct {
-	uint8_t *digit;
-	uint32_t size;
-} uint1024_t;
-
-typedef struct {
-	uint1024_t *quot;
-	uint1024_t *rem;
-} uint1024_div;
-
-uint1024_t *uint1024_from_uint(unsigned int x);
-
-int compare(uint1024_t *x, uint1024_t *y);
-
-uint1024_t *add(uint1024_t *x, uint1024_t *y);
-void ladd(uint1024_t *x, uint1024_t *y);
-void inc(uint1024_t *x);
-
-uint1024_t *substract(uint1024_t *x, uint1024_t *y);
-void lsubstract(uint1024_t *x, uint1024_t *y);
-void dec(uint1024_t *x);
-
-uint1024_t *mult(uint1024_t *x, uint1024_t *y);
-void lmult(uint1024_t *x, uint1024_t *y);
-
-uint1024_div divmod(uint1024_t *dividend, uint1024_t *divisor);
-void ldivmod(uint1024_t *dividend, uint1024_t *divisor, uint1024_t *mod);
-
-uint1024_t *divide(uint1024_t *dividend, uint1024_t *divisor);
-void ldivide(uint1024_t *dividend, uint1024_t *divisor);
-
-uint1024_t *mod(uint1024_t *dividend, uint1024_t *divisor);
-void lmod(uint1024_t *dividend, uint1024_t *divisor);
-
-char *to_str(uint1024_t *x);
-void printf_uint1024(char *format, uint1024_t *x);
-uint1024_t *scan_uint1024(char *str);
+#ifndef UINT1024_INCLUDED
+#define UINT1024_INCLUDED
+
+#define UINT_BITS 1024
+#include "uint_template.h"
+#undef UINT_BITS
+
+#define UINT1024_BITS 1024
+#define UINT1024_LIMBS (1024 / 64)
+#define UINT1024_DEC_SIZE UINT_DEC_SIZE(1024)
+#define UINT1024_HEX_SIZE UINT_HEX_SIZE(1024)
+
+/* the original unprefixed names of the 1024-bit type */
+static inline int compare(const uint1024_t *x, const uint1024_t *y) { return uint1024_compare(x, y); }
+static inline bool is_zero(const uint1024_t *x) { return uint1024_is_zero(x); }
+static inline uint1024_t add(const uint1024_t *x, const uint1024_t *y) { return uint1024_add(x, y); }
+static inline bool ladd(uint1024_t *x, const uint1024_t *y) { return uint1024_ladd(x, y); }
+static inline bool inc(uint1024_t *x) { return uint1024_inc(x); }
+static inline uint1024_t substract(const uint1024_t *x, const uint1024_t *y) { return uint1024_substract(x, y); }
+static inline bool lsubstract(uint1024_t *x, const uint1024_t *y) { return uint1024_lsubstract(x, y); }
+static inline bool dec(uint1024_t *x) { return uint1024_dec(x); }
+static inline uint1024_t mult(const uint1024_t *x, const uint1024_t *y) { return uint1024_mult(x, y); }
+static inline void lmult(uint1024_t *x, const uint1024_t *y) { uint1024_lmult(x, y); }
+static inline uint1024_t sqr(const uint1024_t *x) { return uint1024_sqr(x); }
+static inline bool lpow(uint1024_t *x, uint64_t exponent) { return uint1024_lpow(x, exponent); }
+static inline uint1024_wide mult_full(const uint1024_t *x, const uint1024_t *y) { return uint1024_mult_full(x, y); }
+static inline uint1024_div divmod(const uint1024_t *dividend, const uint1024_t *divisor) { return uint1024_divmod(dividend, divisor); }
+static inline void ldivmod(uint1024_t *dividend, const uint1024_t *divisor, uint1024_t *mod) { uint1024_ldivmod(dividend, divisor, mod); }
+static inline uint1024_t divide(const uint1024_t *dividend, const uint1024_t *divisor) { return uint1024_divide(dividend, divisor); }
+static inline void ldivide(uint1024_t *dividend, const uint1024_t *divisor) { uint1024_ldivide(dividend, divisor); }
+static inline uint1024_t mod(const uint1024_t *dividend, const uint1024_t *divisor) { return uint1024_mod(dividend, divisor); }
+static inline void lmod(uint1024_t *dividend, const uint1024_t *divisor) { uint1024_lmod(dividend, divisor); }
+static inline uint1024_t modmul(const uint1024_mont *ctx, const uint1024_t *x, const uint1024_t *y) { return uint1024_modmul(ctx, x, y); }
+static inline uint1024_t modpow(const uint1024_mont *ctx, const uint1024_t *base, const uint1024_t *exponent) { return uint1024_modpow(ctx, base, exponent); }
+static inline uint1024_t gcd(const uint1024_t *x, const uint1024_t *y) { return uint1024_gcd(x, y); }
+static inline uint1024_t lcm(const uint1024_t *x, const uint1024_t *y) { return uint1024_lcm(x, y); }
+static inline bool modinv(uint1024_t *inverse, const uint1024_t *a, const uint1024_t *m) { return uint1024_modinv(inverse, a, m); }
+static inline char *to_str(const uint1024_t *x) { return uint1024_to_str(x); }
+static inline void printf_uint1024(const char *format, const uint1024_t *x) { uint1024_printf(format, x); }
+static inline uint1024_t scan_uint1024(const char *str) { return uint1024_scan(str); }
+static inline uint1024_t scan_uint1024_hex(const char *str) { return uint1024_scan_hex(str); }
+
+#endif
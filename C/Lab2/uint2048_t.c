@@ -0,0 +1,4 @@
+#include "uint2048_t.h"
+
+#define UINT_BITS 2048
+#include "uint_template.c"
@@ -0,0 +1,13 @@
+#ifndef UINT2048_INCLUDED
+#define UINT2048_INCLUDED
+
+#define UINT_BITS 2048
+#include "uint_template.h"
+#undef UINT_BITS
+
+#define UINT2048_BITS 2048
+#define UINT2048_LIMBS (2048 / 64)
+#define UINT2048_DEC_SIZE UINT_DEC_SIZE(2048)
+#define UINT2048_HEX_SIZE UINT_HEX_SIZE(2048)
+
+#endif
@@ -0,0 +1,4 @@
+#include "uint256_t.h"
+
+#define UINT_BITS 256
+#include "uint_template.c"
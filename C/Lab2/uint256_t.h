@@ -0,0 +1,13 @@
+#ifndef UINT256_INCLUDED
+#define UINT256_INCLUDED
+
+#define UINT_BITS 256
+#include "uint_template.h"
+#undef UINT_BITS
+
+#define UINT256_BITS 256
+#define UINT256_LIMBS (256 / 64)
+#define UINT256_DEC_SIZE UINT_DEC_SIZE(256)
+#define UINT256_HEX_SIZE UINT_HEX_SIZE(256)
+
+#endif
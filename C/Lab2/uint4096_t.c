@@ -0,0 +1,4 @@
+#include "uint4096_t.h"
+
+#define UINT_BITS 4096
+#include "uint_template.c"
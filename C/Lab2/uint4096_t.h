@@ -0,0 +1,13 @@
+#ifndef UINT4096_INCLUDED
+#define UINT4096_INCLUDED
+
+#define UINT_BITS 4096
+#include "uint_template.h"
+#undef UINT_BITS
+
+#define UINT4096_BITS 4096
+#define UINT4096_LIMBS (4096 / 64)
+#define UINT4096_DEC_SIZE UINT_DEC_SIZE(4096)
+#define UINT4096_HEX_SIZE UINT_HEX_SIZE(4096)
+
+#endif
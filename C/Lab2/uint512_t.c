@@ -0,0 +1,4 @@
+#include "uint512_t.h"
+
+#define UINT_BITS 512
+#include "uint_template.c"
@@ -0,0 +1,13 @@
+#ifndef UINT512_INCLUDED
+#define UINT512_INCLUDED
+
+#define UINT_BITS 512
+#include "uint_template.h"
+#undef UINT_BITS
+
+#define UINT512_BITS 512
+#define UINT512_LIMBS (512 / 64)
+#define UINT512_DEC_SIZE UINT_DEC_SIZE(512)
+#define UINT512_HEX_SIZE UINT_HEX_SIZE(512)
+
+#endif
@@ -0,0 +1,1089 @@
+/*
+ * Implementation of every width, included by uintB_t.c after its header with UINT_BITS
+ * set to B. Loop bounds over all limbs are the constant N, public names go through UINT_NAME.
+ */
+#include <stdbool.h>
+#include <iso646.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+#ifndef __has_builtin
+#define __has_builtin(x) 0
+#endif
+
+#define N (UINT_BITS / 64)
+#define uint_t UINT_NAME(t)
+#define uint_div UINT_NAME(div)
+#define uint_wide UINT_NAME(wide)
+#define uint_mont UINT_NAME(mont)
+#define uint_batch UINT_NAME(batch)
+
+/* largest power of ten in a limb, decimal conversion works in chunks of it */
+#define CHUNK 10000000000000000000ULL
+#define CHUNK_DIGITS 19
+
+/* in limbs and shared by all widths, make tune prints the values measured on this machine */
+#ifndef COMBA_THRESHOLD
+#define COMBA_THRESHOLD 8
+#endif
+#ifndef KARATSUBA_THRESHOLD
+#define KARATSUBA_THRESHOLD 32
+#endif
+
+typedef unsigned __int128 uint128_t;
+
+static inline uint64_t addc(uint64_t x, uint64_t y, uint64_t carry, uint64_t *carry_out) {
+#if __has_builtin(__builtin_addcll)
+	unsigned long long out, sum = __builtin_addcll(x, y, carry, &out);
+	*carry_out = out;
+	return sum;
+#elif defined(__x86_64__)
+	unsigned long long sum;
+	*carry_out = _addcarry_u64(carry, x, y, &sum);
+	return sum;
+#else
+	uint64_t sum = x + y, out = sum < x;
+	out += (sum += carry) < carry;
+	*carry_out = out;
+	return sum;
+#endif
+}
+
+static inline uint64_t subb(uint64_t x, uint64_t y, uint64_t borrow, uint64_t *borrow_out) {
+#if __has_builtin(__builtin_subcll)
+	unsigned long long out, diff = __builtin_subcll(x, y, borrow, &out);
+	*borrow_out = out;
+	return diff;
+#elif defined(__x86_64__)
+	unsigned long long diff;
+	*borrow_out = _subborrow_u64(borrow, x, y, &diff);
+	return diff;
+#else
+	uint64_t diff = x - y, out = x < y;
+	out += diff < borrow;
+	*borrow_out = out;
+	return diff - borrow;
+#endif
+}
+
+/* index of the highest non-zero limb plus one, 0 for zero */
+static int used_limbs(const uint_t *x) {
+	int n = N;
+	while (n > 0 and x->limb[n - 1] == 0)
+		n--;
+	return n;
+}
+
+/* x = x * m + a for x of used limbs, returns the limbs used afterwards, what does not fit is dropped */
+static int lmult_small(uint_t *x, int used, uint64_t m, uint64_t a) {
+	uint64_t carry = a;
+	for (int i = 0; i < used; i++) {
+		uint128_t t = (uint128_t)x->limb[i] * m + carry;
+		x->limb[i] = t;
+		carry = t >> 64;
+	}
+	if (carry and used < N)
+		x->limb[used++] = carry;
+	return used;
+}
+
+/* (hi B + lo) / d for hi < d, so the quotient fits a limb */
+static inline uint64_t div_2by1(uint64_t hi, uint64_t lo, uint64_t d, uint64_t *rem) {
+#if defined(__x86_64__) && defined(__GNUC__)
+	uint64_t quot;
+	__asm__("divq %4" : "=a"(quot), "=d"(*rem) : "a"(lo), "d"(hi), "rm"(d));
+	return quot;
+#else
+	uint128_t t = (uint128_t)hi << 64 | lo;
+	*rem = t % d;
+	return t / d;
+#endif
+}
+
+uint_t UINT_NAME(from_uint)(uint64_t x) {
+	uint_t value = { { x } };
+	return value;
+}
+
+int UINT_NAME(compare)(const uint_t *x, const uint_t *y) {
+	for (int i = N - 1; i >= 0; i--) {
+		if (x->limb[i] != y->limb[i])
+			return x->limb[i] > y->limb[i] ? 1 : -1;
+	}
+	return 0;
+}
+
+bool UINT_NAME(is_zero)(const uint_t *x) {
+	uint64_t any = 0;
+	for (int i = 0; i < N; i++)
+		any |= x->limb[i];
+	return any == 0;
+}
+
+uint_t UINT_NAME(add)(const uint_t *x, const uint_t *y) {
+	uint_t result = *x;
+	UINT_NAME(ladd)(&result, y);
+	return result;
+}
+
+bool UINT_NAME(ladd)(uint_t *x, const uint_t *y) {
+	uint64_t carry = 0;
+	for (int i = 0; i < N; i++)
+		x->limb[i] = addc(x->limb[i], y->limb[i], carry, &carry);
+	return carry;
+}
+
+bool UINT_NAME(inc)(uint_t *x) {
+	for (int i = 0; i < N; i++)
+		if (++x->limb[i] != 0)
+			return false;
+	return true;
+}
+
+uint_t UINT_NAME(substract)(const uint_t *x, const uint_t *y) {
+	uint_t result = *x;
+	UINT_NAME(lsubstract)(&result, y);
+	return result;
+}
+
+bool UINT_NAME(lsubstract)(uint_t *x, const uint_t *y) {
+	uint64_t borrow = 0;
+	for (int i = 0; i < N; i++)
+		x->limb[i] = subb(x->limb[i], y->limb[i], borrow, &borrow);
+	return borrow;
+}
+
+bool UINT_NAME(dec)(uint_t *x) {
+	for (int i = 0; i < N; i++)
+		if (x->limb[i]-- != 0)
+			return false;
+	return true;
+}
+
+static uint64_t add_n(uint64_t *r, const uint64_t *a, const uint64_t *b, int n) {
+	uint64_t carry = 0;
+	for (int i = 0; i < n; i++)
+		r[i] = addc(a[i], b[i], carry, &carry);
+	return carry;
+}
+
+static uint64_t sub_n(uint64_t *r, const uint64_t *a, const uint64_t *b, int n) {
+	uint64_t borrow = 0;
+	for (int i = 0; i < n; i++)
+		r[i] = subb(a[i], b[i], borrow, &borrow);
+	return borrow;
+}
+
+static void add_1(uint64_t *r, int n, uint64_t value) {
+	for (int i = 0; i < n and value; i++)
+		value = (r[i] += value) < value;
+}
+
+/* r = |a - b|, returns whether a < b */
+static bool abs_diff(uint64_t *r, const uint64_t *a, const uint64_t *b, int n) {
+	int i = n - 1;
+	while (i >= 0 and a[i] == b[i])
+		i--;
+	if (i >= 0 and a[i] < b[i]) {
+		sub_n(r, b, a, n);
+		return true;
+	}
+	sub_n(r, a, b, n);
+	return false;
+}
+
+/* operand scanning, r[0..limit) must be zeroed, products above limit are skipped */
+static void mul_schoolbook(uint64_t *r, const uint64_t *a, int na, const uint64_t *b, int nb, int limit) {
+	for (int i = 0; i < na; i++) {
+		uint64_t carry = 0;
+		if (a[i] == 0)
+			continue;
+		for (int j = 0; j < nb and i + j < limit; j++) {
+			uint128_t t = (uint128_t)a[i] * b[j] + r[i + j] + carry;
+			r[i + j] = t;
+			carry = t >> 64;
+		}
+		if (i + nb < limit)
+			r[i + nb] = carry;
+	}
+}
+
+/* product scanning: column k of the product is summed in 128 bits plus a carry limb, only columns below limit */
+static void mul_comba(uint64_t *r, const uint64_t *a, const uint64_t *b, int n, int limit) {
+	uint128_t column = 0;
+	uint64_t top = 0;
+	for (int k = 0; k < limit; k++) {
+		for (int i = k < n ? 0 : k - n + 1; i <= k and i < n; i++) {
+			uint128_t p = (uint128_t)a[i] * b[k - i];
+			column += p;
+			top += column < p;
+		}
+		r[k] = column;
+		column = column >> 64 | (uint128_t)top << 64;
+		top = 0;
+	}
+}
+
+int UINT_NAME(comba_threshold) = COMBA_THRESHOLD;
+int UINT_NAME(karatsuba_threshold) = KARATSUBA_THRESHOLD;
+
+/*
+ * r[0..2n) = a * b, with a = a1 B^h + a0 the middle term is
+ * a0 b1 + a1 b0 = a0 b0 + a1 b1 - (a0 - a1)(b0 - b1), which keeps every operand h limbs long.
+ */
+static void mul_karatsuba(uint64_t *r, const uint64_t *a, const uint64_t *b, int n) {
+	if (n < UINT_NAME(karatsuba_threshold) or n % 2) {
+		mul_comba(r, a, b, n, 2 * n);
+		return;
+	}
+
+	int h = n / 2;
+	uint64_t da[h], db[h], m[n], middle[n], carry;
+	bool negative;
+
+	mul_karatsuba(r, a, b, h);
+	mul_karatsuba(r + n, a + h, b + h, h);
+	negative = abs_diff(da, a, a + h, h) != abs_diff(db, b, b + h, h);
+	mul_karatsuba(m, da, db, h);
+
+	carry = add_n(middle, r, r + n, n);
+	if (negative)
+		carry += add_n(middle, middle, m, n);
+	else
+		carry -= sub_n(middle, middle, m, n);
+	carry += add_n(r + h, r + h, middle, n);
+	add_1(r + h + n, h, carry);
+}
+
+/* r[0..n) = a * b mod B^n: the full low product plus the low halves of both cross products */
+static void mullo_karatsuba(uint64_t *r, const uint64_t *a, const uint64_t *b, int n) {
+	if (n < UINT_NAME(karatsuba_threshold) or n % 2) {
+		mul_comba(r, a, b, n, n);
+		return;
+	}
+
+	int h = n / 2;
+	uint64_t cross[h];
+
+	mul_karatsuba(r, a, b, h);
+	mullo_karatsuba(cross, a + h, b, h);
+	add_n(r + h, r + h, cross, h);
+	mullo_karatsuba(cross, a, b + h, h);
+	add_n(r + h, r + h, cross, h);
+}
+
+/* r[0..limit) = x * y, limit is N for the truncated product and 2N for the full one */
+static void mult_limbs(uint64_t *r, const uint_t *x, const uint_t *y, int limit) {
+	int nx = used_limbs(x), ny = used_limbs(y), n = nx > ny ? nx : ny;
+
+	memset(r, 0, limit * sizeof(uint64_t));
+	/* short operands gain nothing from the column or recursive forms */
+	if (nx < UINT_NAME(comba_threshold) or ny < UINT_NAME(comba_threshold)) {
+		mul_schoolbook(r, x->limb, nx, y->limb, ny, limit);
+		return;
+	}
+	n += n % 2;
+	if (2 * n <= limit)
+		mul_karatsuba(r, x->limb, y->limb, n);
+	else
+		mullo_karatsuba(r, x->limb, y->limb, N);
+}
+
+uint_t UINT_NAME(mult)(const uint_t *x, const uint_t *y) {
+	uint_t result;
+	mult_limbs(result.limb, x, y, N);
+	return result;
+}
+
+uint_wide UINT_NAME(mult_full)(const uint_t *x, const uint_t *y) {
+	uint64_t product[2 * N];
+	uint_wide result;
+
+	mult_limbs(product, x, y, 2 * N);
+	memcpy(result.low.limb, product, sizeof result.low.limb);
+	memcpy(result.high.limb, product + N, sizeof result.high.limb);
+	return result;
+}
+
+void UINT_NAME(lmult)(uint_t *x, const uint_t *y) {
+	*x = UINT_NAME(mult)(x, y);
+}
+
+/*
+ * Squaring by columns: every product a_i a_j with i < j appears twice, so it is summed
+ * once and the column doubled before the diagonal a_i^2 and the carry come in.
+ */
+static void sqr_comba(uint64_t *r, const uint64_t *a, int n, int limit) {
+	uint128_t carry = 0;
+	for (int k = 0; k < limit; k++) {
+		uint128_t column = 0, total;
+		uint64_t top = 0, high;
+
+		for (int i = k < n ? 0 : k - n + 1; i < k - i; i++) {
+			uint128_t p = (uint128_t)a[i] * a[k - i];
+			column += p;
+			top += column < p;
+		}
+		top = top << 1 | (uint64_t)(column >> 127);
+		column <<= 1;
+		if (k % 2 == 0 and k / 2 < n) {
+			uint128_t p = (uint128_t)a[k / 2] * a[k / 2];
+			column += p;
+			top += column < p;
+		}
+		total = column + carry;
+		high = top + (total < carry);
+		r[k] = total;
+		carry = total >> 64 | (uint128_t)high << 64;
+	}
+}
+
+static void sqr_limbs(uint64_t *r, const uint_t *x, int limit) {
+	int n = used_limbs(x);
+
+	if (n >= UINT_NAME(karatsuba_threshold)) {
+		mult_limbs(r, x, x, limit);
+		return;
+	}
+	memset(r, 0, limit * sizeof(uint64_t));
+	sqr_comba(r, x->limb, n, limit);
+}
+
+uint_t UINT_NAME(sqr)(const uint_t *x) {
+	uint_t result;
+	sqr_limbs(result.limb, x, N);
+	return result;
+}
+
+static int bit_length(const uint_t *x) {
+	int n = used_limbs(x);
+	return n ? 64 * n - __builtin_clzll(x->limb[n - 1]) : 0;
+}
+
+/*
+ * r = x y mod 2^B, sets overflow when the product does not fit. The full product
+ * is only formed when the lengths say it may not, r may be x or y.
+ */
+static void mult_checked(uint_t *r, const uint_t *x, const uint_t *y, bool *overflow) {
+	uint64_t product[2 * N];
+	int limit = bit_length(x) + bit_length(y) <= UINT_BITS ? N : 2 * N;
+
+	if (x == y)
+		sqr_limbs(product, x, limit);
+	else
+		mult_limbs(product, x, y, limit);
+	for (int i = N; i < limit; i++)
+		*overflow |= product[i] != 0;
+	memcpy(r->limb, product, sizeof r->limb);
+}
+
+/*
+ * Left-to-right sliding window: runs of up to w bits that start and end with a one
+ * are looked up in a table of the odd powers x, x^3 .. x^(2^w - 1), zeros between them only square.
+ * Once x > 1 the powers only grow, so an overflow of any step is an overflow of the result.
+ */
+bool UINT_NAME(lpow)(uint_t *x, uint64_t exponent) {
+	int bits = exponent ? 64 - __builtin_clzll(exponent) : 0;
+	int w = bits <= 8 ? 1 : bits <= 24 ? 3 : 4;
+	uint_t table[1 << (w - 1)], square, result = UINT_NAME(from_uint)(1);
+	/* entries the exponent does not use may overflow on their own, so each keeps its flag */
+	bool overflows[1 << (w - 1)], overflow = false, one = true;
+
+	table[0] = *x;
+	overflows[0] = false;
+	if (w > 1)
+		mult_checked(&square, x, x, &overflow);
+	for (int i = 1; i < 1 << (w - 1); i++) {
+		overflows[i] = overflows[i - 1] or overflow;
+		mult_checked(&table[i], &table[i - 1], &square, &overflows[i]);
+	}
+
+	overflow = false;
+	for (int i = bits - 1; i >= 0;) {
+		int low = i - w + 1 < 0 ? 0 : i - w + 1;
+		unsigned window;
+
+		if (not (exponent >> i & 1)) {
+			if (not one)
+				mult_checked(&result, &result, &result, &overflow);
+			i--;
+			continue;
+		}
+		while (not (exponent >> low & 1))
+			low++;
+		window = exponent >> low & ((1U << (i - low + 1)) - 1);
+		for (int j = low; j <= i and not one; j++)
+			mult_checked(&result, &result, &result, &overflow);
+		if (one)
+			result = table[window >> 1];
+		else
+			mult_checked(&result, &result, &table[window >> 1], &overflow);
+		overflow |= overflows[window >> 1];
+		one = false;
+		i = low - 1;
+	}
+	*x = result;
+	return overflow;
+}
+
+uint_t UINT_NAME(pow)(const uint_t *x, uint64_t exponent) {
+	uint_t result = *x;
+	UINT_NAME(lpow)(&result, exponent);
+	return result;
+}
+
+/*
+ * Knuth's algorithm D (TAOCP 4.3.1) for a divisor of n >= 2 limbs: the divisor is shifted
+ * until its top bit is set, then every quotient limb is estimated from the top two limbs
+ * of the remainder, corrected with the second divisor limb and fixed up at most once
+ * after the subtraction. u[0..m] holds the dividend and is left with the remainder.
+ */
+static void divide_knuth(uint64_t *q, uint64_t *u, int m, const uint64_t *divisor, int n) {
+	int shift = __builtin_clzll(divisor[n - 1]);
+	uint64_t v[n];
+
+	for (int i = n - 1; i > 0; i--)
+		v[i] = shift ? divisor[i] << shift | divisor[i - 1] >> (64 - shift) : divisor[i];
+	v[0] = divisor[0] << shift;
+	for (int i = m; i > 0; i--)
+		u[i] = shift ? u[i] << shift | u[i - 1] >> (64 - shift) : u[i];
+	u[0] <<= shift;
+
+	for (int j = m - n; j >= 0; j--) {
+		uint64_t qhat, rhat, carry = 0, borrow = 0;
+		bool rhat_overflow = false;
+
+		if (u[j + n] >= v[n - 1]) {
+			/* the estimate would not fit a limb, B - 1 is at most two too large */
+			qhat = ~0ULL;
+			rhat = u[j + n - 1] + v[n - 1];
+			rhat_overflow = rhat < v[n - 1];
+		}
+		else
+			qhat = div_2by1(u[j + n], u[j + n - 1], v[n - 1], &rhat);
+		while (not rhat_overflow and (uint128_t)qhat * v[n - 2] > ((uint128_t)rhat << 64 | u[j + n - 2])) {
+			qhat--;
+			rhat += v[n - 1];
+			rhat_overflow = rhat < v[n - 1];
+		}
+
+		for (int i = 0; i < n; i++) {
+			uint128_t p = (uint128_t)qhat * v[i] + carry;
+			carry = p >> 64;
+			u[i + j] = subb(u[i + j], p, borrow, &borrow);
+		}
+		u[j + n] = subb(u[j + n], carry, borrow, &borrow);
+		if (borrow) {
+			qhat--;
+			carry = 0;
+			for (int i = 0; i < n; i++)
+				u[i + j] = addc(u[i + j], v[i], carry, &carry);
+			u[j + n] += carry;
+		}
+		q[j] = qhat;
+	}
+
+	for (int i = 0; i < n; i++)
+		u[i] = shift ? u[i] >> shift | u[i + 1] << (64 - shift) : u[i];
+	memset(u + n, 0, (m + 1 - n) * sizeof(uint64_t));
+}
+
+/* quot and rem may alias the operands or be NULL when not needed, nothing is allocated */
+static void divmod_limbs(uint64_t *quot, uint64_t *rem, const uint_t *dividend, const uint_t *divisor) {
+	int m = used_limbs(dividend), n = used_limbs(divisor);
+	uint64_t u[N + 1], q[N] = { 0 };
+
+	memcpy(u, dividend->limb, sizeof dividend->limb);
+	u[N] = 0;
+	if (n == 1) {
+		uint64_t r = 0;
+		for (int i = m - 1; i >= 0; i--)
+			q[i] = div_2by1(r, u[i], divisor->limb[0], &r);
+		memset(u, 0, sizeof u);
+		u[0] = r;
+	}
+	else if (n > 1 and m >= n)
+		divide_knuth(q, u, m, divisor->limb, n);
+
+	if (quot != NULL)
+		memcpy(quot, q, sizeof q);
+	if (rem != NULL)
+		memcpy(rem, u, N * sizeof(uint64_t));
+}
+
+uint_div UINT_NAME(divmod)(const uint_t *dividend, const uint_t *divisor) {
+	uint_div result;
+	divmod_limbs(result.quot.limb, result.rem.limb, dividend, divisor);
+	return result;
+}
+
+void UINT_NAME(ldivmod)(uint_t *dividend, const uint_t *divisor, uint_t *mod) {
+	divmod_limbs(dividend->limb, mod->limb, dividend, divisor);
+}
+
+uint_t UINT_NAME(divide)(const uint_t *dividend, const uint_t *divisor) {
+	uint_t result;
+	divmod_limbs(result.limb, NULL, dividend, divisor);
+	return result;
+}
+
+void UINT_NAME(ldivide)(uint_t *dividend, const uint_t *divisor) {
+	divmod_limbs(dividend->limb, NULL, dividend, divisor);
+}
+
+uint_t UINT_NAME(mod)(const uint_t *dividend, const uint_t *divisor) {
+	uint_t result;
+	divmod_limbs(NULL, result.limb, dividend, divisor);
+	return result;
+}
+
+void UINT_NAME(lmod)(uint_t *dividend, const uint_t *divisor) {
+	divmod_limbs(NULL, dividend->limb, dividend, divisor);
+}
+
+/*
+ * Montgomery form of x is x R mod m with R = B^n for a modulus of n limbs:
+ * t = a b R^-1 mod m, interleaving each row of the product with the reduction
+ * that clears its lowest limb (CIOS). a, b < m gives t < 2m before the final subtraction.
+ */
+static void montmul(uint64_t *r, const uint64_t *a, const uint64_t *b, const uint_mont *ctx) {
+	const uint64_t *m = ctx->modulus.limb;
+	int n = ctx->limbs;
+	uint64_t t[n + 2];
+
+	memset(t, 0, sizeof t);
+	for (int i = 0; i < n; i++) {
+		uint64_t carry = 0, q;
+		uint128_t p;
+
+		for (int j = 0; j < n; j++) {
+			p = (uint128_t)a[j] * b[i] + t[j] + carry;
+			t[j] = p;
+			carry = p >> 64;
+		}
+		t[n] = addc(t[n], carry, 0, &carry);
+		t[n + 1] = carry;
+
+		q = t[0] * ctx->inverse;
+		p = (uint128_t)q * m[0] + t[0];
+		carry = p >> 64;
+		for (int j = 1; j < n; j++) {
+			p = (uint128_t)q * m[j] + t[j] + carry;
+			t[j - 1] = p;
+			carry = p >> 64;
+		}
+		t[n - 1] = addc(t[n], carry, 0, &carry);
+		t[n] = t[n + 1] + carry;
+	}
+
+	uint64_t borrow = sub_n(r, t, m, n);
+	/* t < m exactly when the subtraction borrows past the extra limb */
+	if (borrow > t[n])
+		memcpy(r, t, n * sizeof(uint64_t));
+}
+
+/* x = 2x mod m for x < m */
+static void double_mod(uint_t *x, const uint_t *m) {
+	uint64_t top = x->limb[N - 1] >> 63;
+	for (int i = N - 1; i > 0; i--)
+		x->limb[i] = x->limb[i] << 1 | x->limb[i - 1] >> 63;
+	x->limb[0] <<= 1;
+	if (top or UINT_NAME(compare)(x, m) >= 0)
+		UINT_NAME(lsubstract)(x, m);
+}
+
+/* -m^-1 mod 2^64 for odd m: Newton's iteration doubles the correct low bits, m is its own inverse mod 8 */
+static uint64_t negative_inverse(uint64_t m) {
+	uint64_t inverse = m;
+	for (int i = 0; i < 5; i++)
+		inverse *= 2 - m * inverse;
+	return -inverse;
+}
+
+bool UINT_NAME(mont_init)(uint_mont *ctx, const uint_t *modulus) {
+	if (not (modulus->limb[0] & 1))
+		return false;
+	ctx->modulus = *modulus;
+	ctx->limbs = used_limbs(modulus);
+	ctx->inverse = negative_inverse(modulus->limb[0]);
+
+	/* R^2 mod m by doubling 1 mod m, once per bit of R^2 */
+	ctx->r2 = UINT_NAME(from_uint)(1);
+	UINT_NAME(lmod)(&ctx->r2, modulus);
+	for (int i = 0; i < 128 * ctx->limbs; i++)
+		double_mod(&ctx->r2, modulus);
+	return true;
+}
+
+/* x R mod m, with x reduced first when it is longer than the modulus */
+static void to_mont(uint64_t *r, const uint_t *x, const uint_mont *ctx) {
+	uint_t reduced;
+	if (used_limbs(x) > ctx->limbs) {
+		divmod_limbs(NULL, reduced.limb, x, &ctx->modulus);
+		x = &reduced;
+	}
+	montmul(r, x->limb, ctx->r2.limb, ctx);
+}
+
+static uint_t from_mont(const uint64_t *x, const uint_mont *ctx) {
+	uint_t result = { { 0 } }, one = { { 1 } };
+	montmul(result.limb, x, one.limb, ctx);
+	return result;
+}
+
+uint_t UINT_NAME(modmul)(const uint_mont *ctx, const uint_t *x, const uint_t *y) {
+	uint64_t a[ctx->limbs], b[ctx->limbs];
+
+	to_mont(a, x, ctx);
+	to_mont(b, y, ctx);
+	montmul(a, a, b, ctx);
+	return from_mont(a, ctx);
+}
+
+/*
+ * Fixed window: the exponent is read from the top in windows of w bits, each one
+ * costs w squarings and a multiplication by base^window from a table of 2^w powers.
+ * Windows of zero multiply by one as well, so the sequence of operations depends
+ * only on the length of the exponent.
+ */
+uint_t UINT_NAME(modpow)(const uint_mont *ctx, const uint_t *base, const uint_t *exponent) {
+	int n = ctx->limbs, bits = 0, w;
+	uint_t one = { { 1 } };
+
+	for (int i = N - 1; i >= 0 and bits == 0; i--)
+		if (exponent->limb[i])
+			bits = 64 * i + 64 - __builtin_clzll(exponent->limb[i]);
+	w = bits < 32 ? 1 : bits < 256 ? 3 : bits < 768 ? 4 : 5;
+
+	uint64_t table[1 << w][n], result[n];
+
+	to_mont(table[0], &one, ctx);
+	to_mont(table[1], base, ctx);
+	for (int i = 2; i < 1 << w; i++)
+		montmul(table[i], table[i - 1], table[1], ctx);
+
+	memcpy(result, table[0], sizeof result);
+	for (int top = (bits + w - 1) / w * w; top > 0; top -= w) {
+		unsigned window = 0;
+		for (int bit = top - 1; bit >= top - w; bit--) {
+			montmul(result, result, result, ctx);
+			window = window << 1 | (bit < bits and exponent->limb[bit / 64] >> bit % 64 & 1);
+		}
+		montmul(result, result, table[window], ctx);
+	}
+	return from_mont(result, ctx);
+}
+
+/* number of trailing zero bits, 0 for zero */
+static int trailing_zeros(const uint_t *x) {
+	for (int i = 0; i < N; i++)
+		if (x->limb[i])
+			return 64 * i + __builtin_ctzll(x->limb[i]);
+	return 0;
+}
+
+/* x >>= bits for bits < B, top is shifted in above the top limb */
+static void shift_right(uint_t *x, int bits, uint64_t top) {
+	int limbs = bits / 64, shift = bits % 64;
+
+	if (limbs) {
+		for (int i = 0; i < N; i++)
+			x->limb[i] = i + limbs < N ? x->limb[i + limbs] : 0;
+		top = 0;
+	}
+	if (shift) {
+		for (int i = 0; i < N - 1; i++)
+			x->limb[i] = x->limb[i] >> shift | x->limb[i + 1] << (64 - shift);
+		x->limb[N - 1] = x->limb[N - 1] >> shift | top << (64 - shift);
+	}
+}
+
+static void shift_left(uint_t *x, int bits) {
+	int limbs = bits / 64, shift = bits % 64;
+
+	for (int i = N - 1; i >= 0; i--)
+		x->limb[i] = i >= limbs ? x->limb[i - limbs] : 0;
+	if (shift) {
+		for (int i = N - 1; i > 0; i--)
+			x->limb[i] = x->limb[i] << shift | x->limb[i - 1] >> (64 - shift);
+		x->limb[0] <<= shift;
+	}
+}
+
+/*
+ * Binary GCD: the common power of two is taken out once, then the smaller odd value is
+ * subtracted from the larger one and all trailing zeros of the difference are dropped at once.
+ */
+uint_t UINT_NAME(gcd)(const uint_t *x, const uint_t *y) {
+	uint_t values[2] = { *x, *y }, *a = &values[0], *b = &values[1], *t;
+	int shift;
+
+	if (UINT_NAME(is_zero)(a))
+		return *b;
+	if (UINT_NAME(is_zero)(b))
+		return *a;
+	shift = trailing_zeros(a) < trailing_zeros(b) ? trailing_zeros(a) : trailing_zeros(b);
+	shift_right(a, trailing_zeros(a), 0);
+	do {
+		shift_right(b, trailing_zeros(b), 0);
+		if (UINT_NAME(compare)(a, b) > 0)
+			t = a, a = b, b = t;
+		UINT_NAME(lsubstract)(b, a);
+	} while (not UINT_NAME(is_zero)(b));
+	shift_left(a, shift);
+	return *a;
+}
+
+/* x / gcd * y, wrapping like mult, 0 when either is 0 */
+uint_t UINT_NAME(lcm)(const uint_t *x, const uint_t *y) {
+	uint_t g = UINT_NAME(gcd)(x, y), result;
+
+	if (UINT_NAME(is_zero)(&g))
+		return g;
+	divmod_limbs(result.limb, NULL, x, &g);
+	UINT_NAME(lmult)(&result, y);
+	return result;
+}
+
+/*
+ * x = x / 2^bits mod m for odd m and x < m: adding the multiple of m that clears
+ * the low bits, t = -x m^-1 mod 2^s, lets up to 63 bits go in one shift.
+ */
+static void halve_mod(uint_t *x, int bits, const uint_t *m, uint64_t inverse) {
+	while (bits > 0) {
+		int s = bits < 63 ? bits : 63;
+		uint64_t t = x->limb[0] * inverse & ((1ULL << s) - 1), carry = 0;
+
+		for (int i = 0; i < N; i++) {
+			uint128_t p = (uint128_t)t * m->limb[i] + x->limb[i] + carry;
+			x->limb[i] = p;
+			carry = p >> 64;
+		}
+		shift_right(x, s, carry);
+		bits -= s;
+	}
+}
+
+/* x = x - y mod m for x, y < m */
+static void sub_mod(uint_t *x, const uint_t *y, const uint_t *m) {
+	if (UINT_NAME(lsubstract)(x, y))
+		UINT_NAME(ladd)(x, m);
+}
+
+/*
+ * Binary extended Euclid for odd m: u = x1 a and v = x2 a mod m hold throughout,
+ * halving u halves x1 mod m and the subtractions carry over to the coefficients.
+ */
+static bool modinv_odd(uint_t *inverse, const uint_t *a, const uint_t *m) {
+	uint_t u, v = *m, x1 = UINT_NAME(from_uint)(1), x2 = UINT_NAME(from_uint)(0);
+	uint64_t minus_inverse = negative_inverse(m->limb[0]);
+	int zeros;
+
+	divmod_limbs(NULL, u.limb, a, m);
+	while (not UINT_NAME(is_zero)(&u)) {
+		zeros = trailing_zeros(&u);
+		shift_right(&u, zeros, 0);
+		halve_mod(&x1, zeros, m, minus_inverse);
+		zeros = trailing_zeros(&v);
+		shift_right(&v, zeros, 0);
+		halve_mod(&x2, zeros, m, minus_inverse);
+
+		if (UINT_NAME(compare)(&u, &v) >= 0) {
+			UINT_NAME(lsubstract)(&u, &v);
+			sub_mod(&x1, &x2, m);
+		}
+		else {
+			UINT_NAME(lsubstract)(&v, &u);
+			sub_mod(&x2, &x1, m);
+		}
+	}
+	/* v ends as gcd(a, m) */
+	if (not (v.limb[0] == 1 and used_limbs(&v) == 1))
+		return false;
+	*inverse = x2;
+	return true;
+}
+
+/*
+ * Extended Euclid with Knuth division for even m. The coefficients alternate
+ * in sign and stay below m in magnitude, so only magnitudes are kept.
+ */
+static bool modinv_even(uint_t *inverse, const uint_t *a, const uint_t *m) {
+	uint_t r0 = *m, r1, t0 = UINT_NAME(from_uint)(0), t1 = UINT_NAME(from_uint)(1), q, t;
+	bool t1_negative = false;
+
+	divmod_limbs(NULL, r1.limb, a, m);
+	while (not UINT_NAME(is_zero)(&r1)) {
+		divmod_limbs(q.limb, t.limb, &r0, &r1);
+		r0 = r1;
+		r1 = t;
+		t = UINT_NAME(mult)(&q, &t1);
+		UINT_NAME(ladd)(&t, &t0);
+		t0 = t1;
+		t1 = t;
+		t1_negative = not t1_negative;
+	}
+	if (not (r0.limb[0] == 1 and used_limbs(&r0) == 1))
+		return false;
+	/* t0 carries the sign opposite to t1 */
+	*inverse = t1_negative ? t0 : UINT_NAME(substract)(m, &t0);
+	return true;
+}
+
+bool UINT_NAME(modinv)(uint_t *inverse, const uint_t *a, const uint_t *m) {
+	if (UINT_NAME(is_zero)(m))
+		return false;
+	if (m->limb[0] == 1 and used_limbs(m) == 1) {
+		*inverse = UINT_NAME(from_uint)(0);
+		return true;
+	}
+	return m->limb[0] & 1 ? modinv_odd(inverse, a, m) : modinv_even(inverse, a, m);
+}
+
+/* digits of 2^B - 1 and the levels needed to split them into chunks */
+#define DEC_DIGITS (UINT_DEC_SIZE(UINT_BITS) - 1)
+#define DEC_LEVELS (DEC_DIGITS <= 19 ? 0 : DEC_DIGITS <= 38 ? 1 : DEC_DIGITS <= 76 ? 2 : DEC_DIGITS <= 152 ? 3 : \
+	DEC_DIGITS <= 304 ? 4 : DEC_DIGITS <= 608 ? 5 : DEC_DIGITS <= 1216 ? 6 : DEC_DIGITS <= 2432 ? 7 : 8)
+
+/* 10^(19 2^k), the divisors of each level of decimal conversion, the last one is still below 2^B */
+static uint_t decimal_powers[DEC_LEVELS];
+
+static const char digit_pairs[201] =
+	"00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+	"40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+	"8081828384858687888990919293949596979899";
+
+__attribute__((constructor))
+static void init_decimal_powers(void) {
+	decimal_powers[0] = UINT_NAME(from_uint)(CHUNK);
+	for (int k = 1; k < DEC_LEVELS; k++)
+		decimal_powers[k] = UINT_NAME(mult)(&decimal_powers[k - 1], &decimal_powers[k - 1]);
+}
+
+/* writes the CHUNK_DIGITS digits of x < 10^19 two at a time, or only the significant ones unless pad */
+static char *write_chunk(char *p, uint64_t x, bool pad) {
+	char digits[CHUNK_DIGITS + 1];
+	int i = CHUNK_DIGITS + 1;
+
+	while (x >= 100) {
+		i -= 2;
+		memcpy(digits + i, digit_pairs + x % 100 * 2, 2);
+		x /= 100;
+	}
+	i -= 2;
+	memcpy(digits + i, digit_pairs + x * 2, 2);
+	if (pad) {
+		memset(digits, '0', i);
+		i = 1;
+	}
+	else if (x < 10)
+		i++;
+	memcpy(p, digits + i, CHUNK_DIGITS + 1 - i);
+	return p + CHUNK_DIGITS + 1 - i;
+}
+
+/*
+ * x < 10^(19 2^k) is split by 10^(19 2^(k - 1)) into halves converted on their own,
+ * so the long divisions shrink with every level instead of walking all limbs per chunk.
+ */
+static char *write_decimal(char *p, const uint_t *x, int k, bool pad) {
+	uint_t high, low;
+
+	if (k == 0)
+		return write_chunk(p, x->limb[0], pad);
+	/* below 10^38 the high chunk is less than 10^19 as well, one 2-by-1 division splits them */
+	if (k == 1) {
+		uint64_t rem, quot = div_2by1(x->limb[1], x->limb[0], CHUNK, &rem);
+		if (pad or quot)
+			p = write_chunk(p, quot, pad);
+		return write_chunk(p, rem, pad or quot);
+	}
+	if (not pad and UINT_NAME(compare)(x, &decimal_powers[k - 1]) < 0)
+		return write_decimal(p, x, k - 1, false);
+	divmod_limbs(high.limb, low.limb, x, &decimal_powers[k - 1]);
+	p = write_decimal(p, &high, k - 1, pad);
+	return write_decimal(p, &low, k - 1, true);
+}
+
+/* snprintf-like: returns the length of the full string and writes it only if size is enough */
+size_t UINT_NAME(to_dec)(const uint_t *x, char *buf, size_t size) {
+	char digits[UINT_DEC_SIZE(UINT_BITS)];
+	size_t length = write_decimal(digits, x, DEC_LEVELS, false) - digits;
+
+	if (length < size) {
+		memcpy(buf, digits, length);
+		buf[length] = '\0';
+	}
+	return length;
+}
+
+size_t UINT_NAME(to_hex)(const uint_t *x, char *buf, size_t size) {
+	static const char hex[] = "0123456789abcdef";
+	int n = used_limbs(x), top = n ? 16 - __builtin_clzll(x->limb[n - 1]) / 4 : 1;
+	size_t length = n ? (size_t)(n - 1) * 16 + top : 1;
+
+	if (length >= size)
+		return length;
+	buf[length] = '\0';
+	for (size_t i = 0; i < length; i++) {
+		uint64_t limb = n ? x->limb[i / 16] : 0;
+		buf[length - 1 - i] = hex[limb >> i % 16 * 4 & 15];
+	}
+	return length;
+}
+
+char *UINT_NAME(to_str)(const uint_t *x) {
+	char *str = malloc(UINT_DEC_SIZE(UINT_BITS));
+	if (str != NULL)
+		UINT_NAME(to_dec)(x, str, UINT_DEC_SIZE(UINT_BITS));
+	return str;
+}
+
+void UINT_NAME(printf)(const char *format, const uint_t *x) {
+	char str[UINT_DEC_SIZE(UINT_BITS)];
+	UINT_NAME(to_dec)(x, str, sizeof str);
+	printf(format, str);
+}
+
+static int hex_digit(char c) {
+	if (c >= '0' and c <= '9')
+		return c - '0';
+	if ((c | 0x20) >= 'a' and (c | 0x20) <= 'f')
+		return (c | 0x20) - 'a' + 10;
+	return -1;
+}
+
+/* reads hex digits up to the first other character, digits above the top limb are dropped */
+uint_t UINT_NAME(scan_hex)(const char *str) {
+	uint_t result = { { 0 } };
+	size_t length = 0;
+
+	while (hex_digit(str[length]) >= 0)
+		length++;
+	for (size_t i = 0; i < length and i < 16 * N; i++)
+		result.limb[i / 16] |= (uint64_t)hex_digit(str[length - 1 - i]) << i % 16 * 4;
+	return result;
+}
+
+/*
+ * reads decimal digits up to the first other character, overflow wraps;
+ * a 0x prefix switches to hex. Every chunk of 19 digits is one multiply-add over the limbs used so far.
+ */
+uint_t UINT_NAME(scan)(const char *str) {
+	uint_t result = { { 0 } };
+	uint64_t chunk = 0, scale = 1;
+	int used = 0;
+
+	if (str[0] == '0' and (str[1] | 0x20) == 'x')
+		return UINT_NAME(scan_hex)(str + 2);
+	for (; *str >= '0' and *str <= '9'; str++) {
+		chunk = chunk * 10 + (*str - '0');
+		scale *= 10;
+		if (scale == CHUNK) {
+			used = lmult_small(&result, used, scale, chunk);
+			chunk = 0;
+			scale = 1;
+		}
+	}
+	if (scale > 1)
+		lmult_small(&result, used, scale, chunk);
+	return result;
+}
+
+/* batches are processed in blocks of this many values, which keeps the carries of a block in registers or L1 */
+#define BATCH_BLOCK 256
+/* every limb array starts on a cache line */
+#define BATCH_ALIGN 8
+
+bool UINT_NAME(batch_alloc)(uint_batch *batch, size_t count) {
+	size_t stride = (count + BATCH_ALIGN - 1) / BATCH_ALIGN * BATCH_ALIGN;
+	uint64_t *data = aligned_alloc(BATCH_ALIGN * sizeof(uint64_t), (stride ? stride : BATCH_ALIGN) * N * sizeof(uint64_t));
+
+	if (data == NULL)
+		return false;
+	for (int i = 0; i < N; i++)
+		batch->limb[i] = data + i * stride;
+	batch->count = count;
+	return true;
+}
+
+void UINT_NAME(batch_free)(uint_batch *batch) {
+	free(batch->limb[0]);
+	batch->limb[0] = NULL;
+	batch->count = 0;
+}
+
+void UINT_NAME(batch_set)(uint_batch *batch, size_t index, const uint_t *x) {
+	for (int i = 0; i < N; i++)
+		batch->limb[i][index] = x->limb[i];
+}
+
+uint_t UINT_NAME(batch_get)(const uint_batch *batch, size_t index) {
+	uint_t x;
+	for (int i = 0; i < N; i++)
+		x.limb[i] = batch->limb[i][index];
+	return x;
+}
+
+/*
+ * The loops over values within one limb have no dependency between iterations,
+ * so they vectorize: the carry of every value lives in its own lane.
+ */
+#if defined(__x86_64__) && defined(__GNUC__) && !defined(__clang__)
+#define BATCH_KERNEL __attribute__((target_clones("avx2", "default"), optimize("tree-vectorize")))
+#else
+#define BATCH_KERNEL
+#endif
+
+BATCH_KERNEL
+void UINT_NAME(add_n)(uint_batch *out, const uint_batch *a, const uint_batch *b, size_t count) {
+	for (size_t start = 0; start < count; start += BATCH_BLOCK) {
+		size_t block = count - start < BATCH_BLOCK ? count - start : BATCH_BLOCK;
+		uint64_t carry[BATCH_BLOCK] = { 0 };
+
+		for (int i = 0; i < N; i++) {
+			const uint64_t *x = a->limb[i] + start, *y = b->limb[i] + start;
+			uint64_t *r = out->limb[i] + start;
+			for (size_t k = 0; k < block; k++) {
+				uint64_t sum = x[k] + y[k], total = sum + carry[k];
+				carry[k] = (sum < x[k]) | (total < sum);
+				r[k] = total;
+			}
+		}
+	}
+}
+
+BATCH_KERNEL
+void UINT_NAME(sub_n)(uint_batch *out, const uint_batch *a, const uint_batch *b, size_t count) {
+	for (size_t start = 0; start < count; start += BATCH_BLOCK) {
+		size_t block = count - start < BATCH_BLOCK ? count - start : BATCH_BLOCK;
+		uint64_t borrow[BATCH_BLOCK] = { 0 };
+
+		for (int i = 0; i < N; i++) {
+			const uint64_t *x = a->limb[i] + start, *y = b->limb[i] + start;
+			uint64_t *r = out->limb[i] + start;
+			for (size_t k = 0; k < block; k++) {
+				uint64_t diff = x[k] - y[k], total = diff - borrow[k];
+				borrow[k] = (x[k] < y[k]) | (diff < borrow[k]);
+				r[k] = total;
+			}
+		}
+	}
+}
+
+/*
+ * AVX2 has no 64 by 64 bit multiply, four 32-bit products per limb lose to one scalar mul,
+ * so every value is multiplied on its own, gathered from and scattered back to the limb arrays.
+ */
+void UINT_NAME(mul_n)(uint_batch *out, const uint_batch *a, const uint_batch *b, size_t count) {
+	for (size_t k = 0; k < count; k++) {
+		uint_t x = UINT_NAME(batch_get)(a, k), y = UINT_NAME(batch_get)(b, k), product;
+		mult_limbs(product.limb, &x, &y, N);
+		UINT_NAME(batch_set)(out, k, &product);
+	}
+}
@@ -0,0 +1,137 @@
+/*
+ * Declarations of one width, included by uintB_t.h with UINT_BITS set to B, a multiple of 64.
+ * Every name gets the uintB_ prefix, so any number of widths can be used together.
+ */
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifndef UINT_TEMPLATE_INCLUDED
+#define UINT_TEMPLATE_INCLUDED
+
+#define UINT_PASTE(a, b, c) a ## b ## c
+#define UINT_EXPAND(a, b, c) UINT_PASTE(a, b, c)
+/* UINT_NAME(add) is uintB_add for the width being declared or defined */
+#define UINT_NAME(name) UINT_EXPAND(uint, UINT_BITS, _ ## name)
+
+/* buffer sizes including the terminating zero, 2^B - 1 has B log10(2) + 1 decimal digits */
+#define UINT_DEC_SIZE(bits) ((bits) * 30103L / 100000 + 2)
+#define UINT_HEX_SIZE(bits) ((bits) / 4 + 1)
+
+#endif
+
+#define uint_t UINT_NAME(t)
+#define uint_wide UINT_NAME(wide)
+#define uint_div UINT_NAME(div)
+#define uint_mont UINT_NAME(mont)
+#define uint_batch UINT_NAME(batch)
+
+/* value type, limb[0] is the least significant, arithmetic wraps modulo 2^B */
+typedef struct {
+	uint64_t limb[UINT_BITS / 64];
+} UINT_NAME(t);
+
+/* full product of two uintB_t */
+typedef struct {
+	uint_t low;
+	uint_t high;
+} UINT_NAME(wide);
+
+typedef struct {
+	uint_t quot;
+	uint_t rem;
+} UINT_NAME(div);
+
+uint_t UINT_NAME(from_uint)(uint64_t x);
+
+int UINT_NAME(compare)(const uint_t *x, const uint_t *y);
+bool UINT_NAME(is_zero)(const uint_t *x);
+
+/* l-prefixed functions work in place and return the carry or borrow out of the top limb */
+uint_t UINT_NAME(add)(const uint_t *x, const uint_t *y);
+bool UINT_NAME(ladd)(uint_t *x, const uint_t *y);
+bool UINT_NAME(inc)(uint_t *x);
+
+uint_t UINT_NAME(substract)(const uint_t *x, const uint_t *y);
+bool UINT_NAME(lsubstract)(uint_t *x, const uint_t *y);
+bool UINT_NAME(dec)(uint_t *x);
+
+/* schoolbook for short operands, Comba from uintB_comba_threshold limbs, Karatsuba from uintB_karatsuba_threshold */
+uint_t UINT_NAME(mult)(const uint_t *x, const uint_t *y);
+void UINT_NAME(lmult)(uint_t *x, const uint_t *y);
+uint_wide UINT_NAME(mult_full)(const uint_t *x, const uint_t *y);
+extern int UINT_NAME(comba_threshold), UINT_NAME(karatsuba_threshold);
+
+/* squaring sums each cross product once; lpow returns whether x^exponent did not fit, both wrap */
+uint_t UINT_NAME(sqr)(const uint_t *x);
+uint_t UINT_NAME(pow)(const uint_t *x, uint64_t exponent);
+bool UINT_NAME(lpow)(uint_t *x, uint64_t exponent);
+
+/*
+ * division by zero gives a zero quotient and leaves the dividend as the remainder,
+ * ldivmod leaves the quotient in dividend and the remainder in mod
+ */
+uint_div UINT_NAME(divmod)(const uint_t *dividend, const uint_t *divisor);
+void UINT_NAME(ldivmod)(uint_t *dividend, const uint_t *divisor, uint_t *mod);
+
+uint_t UINT_NAME(divide)(const uint_t *dividend, const uint_t *divisor);
+void UINT_NAME(ldivide)(uint_t *dividend, const uint_t *divisor);
+
+uint_t UINT_NAME(mod)(const uint_t *dividend, const uint_t *divisor);
+void UINT_NAME(lmod)(uint_t *dividend, const uint_t *divisor);
+
+/* per-modulus constants of Montgomery multiplication, the modulus must be odd */
+typedef struct {
+	uint_t modulus;
+	/* R^2 mod modulus for R = 2^(64 limbs) */
+	uint_t r2;
+	/* -modulus^-1 mod 2^64 */
+	uint64_t inverse;
+	int limbs;
+} UINT_NAME(mont);
+
+/* returns false for an even modulus */
+bool UINT_NAME(mont_init)(uint_mont *ctx, const uint_t *modulus);
+/* x y mod m and base^exponent mod m, operands may be of any size */
+uint_t UINT_NAME(modmul)(const uint_mont *ctx, const uint_t *x, const uint_t *y);
+uint_t UINT_NAME(modpow)(const uint_mont *ctx, const uint_t *base, const uint_t *exponent);
+
+/* gcd(0, 0) is 0, modinv returns false when a and m are not coprime or m is 0 */
+uint_t UINT_NAME(gcd)(const uint_t *x, const uint_t *y);
+uint_t UINT_NAME(lcm)(const uint_t *x, const uint_t *y);
+bool UINT_NAME(modinv)(uint_t *inverse, const uint_t *a, const uint_t *m);
+
+/* lowercase hex without a prefix, both return the length and write nothing unless it fits in size */
+size_t UINT_NAME(to_dec)(const uint_t *x, char *buf, size_t size);
+size_t UINT_NAME(to_hex)(const uint_t *x, char *buf, size_t size);
+
+/* to_str returns a malloc'd string, format of uintB_printf takes it as its only %s */
+char *UINT_NAME(to_str)(const uint_t *x);
+void UINT_NAME(printf)(const char *format, const uint_t *x);
+/* uintB_scan takes hex after a 0x prefix */
+uint_t UINT_NAME(scan)(const char *str);
+uint_t UINT_NAME(scan_hex)(const char *str);
+
+/*
+ * Structure of arrays for batches: limb[i][k] is limb i of the k-th value, so the
+ * n functions run over k in the inner loop and vectorize. out may be a or b.
+ */
+typedef struct {
+	uint64_t *limb[UINT_BITS / 64];
+	size_t count;
+} UINT_NAME(batch);
+
+bool UINT_NAME(batch_alloc)(uint_batch *batch, size_t count);
+void UINT_NAME(batch_free)(uint_batch *batch);
+void UINT_NAME(batch_set)(uint_batch *batch, size_t index, const uint_t *x);
+uint_t UINT_NAME(batch_get)(const uint_batch *batch, size_t index);
+
+void UINT_NAME(add_n)(uint_batch *out, const uint_batch *a, const uint_batch *b, size_t count);
+void UINT_NAME(sub_n)(uint_batch *out, const uint_batch *a, const uint_batch *b, size_t count);
+void UINT_NAME(mul_n)(uint_batch *out, const uint_batch *a, const uint_batch *b, size_t count);
+
+#undef uint_t
+#undef uint_wide
+#undef uint_div
+#undef uint_mont
+#undef uint_batch
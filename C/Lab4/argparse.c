@@ -71,15 +71,18 @@ void parse_args(int argc, char **argv, ...) {
 			}
 			invalid_option(argv[arg], argv[0]);
 		}
-		else {
+		else if (current_pos_arg < args_count) {
             POS_ARGS[current_pos_arg].assign(argv[arg], args[current_pos_arg]);
             current_pos_arg++;
 		}
+		else {
+            POS_ARGS[args_count - 1].assign(argv[arg], args[args_count - 1]);
+		}
 end_while:
 		arg++;
 	}
-	if (current_pos_arg < args_count) {
-        
+	/* arguments without a message are optional */
+	if (current_pos_arg < args_count and POS_ARGS[current_pos_arg].message_on_null != NULL) {
 		fprintf(stderr, "%s\n", POS_ARGS[current_pos_arg].message_on_null);
 		fprintf(stderr, USAGE_MESSAGE, argv[0]);
 		exit(1);
@@ -1,14 +1,20 @@
 #include <stdbool.h>
+#include <stdlib.h>
 #include <string.h>
 #include "argparse.h"
 
-const char USAGE_MESSAGE[] = "Usage: %s file.mp3 [-x, --extract-pictures] [-g, --get FRAME1,FRAME2,FRAME3...] [-R, --rewrite] [-s, --set FRAME1=VALUE1,FRAME2=VALUE2...]\n";
+const char USAGE_MESSAGE[] = "Usage: %s file.mp3|directory|pattern... [-j, --jobs N] [-C, --catalog FILE [-q, --query FRAME[=VALUE]]] [-x, --extract-pictures] [-g, --get FRAME1,FRAME2,FRAME3...] [-R, --rewrite] [-z, --compress] [-s, --set FRAME1=VALUE1,FRAME2=VALUE2...]\n";
 
-const char HELP[] = "ID3V2 tag parser. Without arguments prints out all text and comment frames. \nAvailable options are:\n"
+const char HELP[] = "ID3V2 tag parser. Without arguments prints out all text and comment frames.\n"
+                    "Directories are searched for mp3 files, several files are processed in parallel.\nAvailable options are:\n"
 					"    -g, --get              -- Prints out only specified frames\n"
                     "    -s, --set              -- Sets values to frames\n"
                     "    -R, --rewrite          -- Rewrite the whole tag\n"
                     "    -x, --extract-pictures -- Extract APIC frames\n"
+                    "    -z, --compress         -- Compress large frames with zlib when writing the tag\n"
+                    "    -j, --jobs             -- Number of files processed at once, all cores by default\n"
+                    "    -C, --catalog          -- Keep the text frames of the files in a catalog, only changed files are read again\n"
+                    "    -q, --query            -- Prints the files in the catalog with a frame, or a frame with the value\n"
                     "The format of APIC frame is: APIC=[%%]xx:picture.png:Some description\n"
                     "Where xx is the hexadecimal picture type and if you want to embed an image, precede a %% before type\n";
 
@@ -21,13 +27,33 @@ void set_str(char *arg, void *pvar) {
     *(char **)pvar = arg;
 }
 
+void set_int(char *arg, void *pvar) {
+    *(int *)pvar = atoi(arg);
+}
+
+/* appends to a NULL-terminated array */
+void add_str(char *arg, void *pvar) {
+    char ***array = pvar;
+    int count = 0;
+    while (*array and (*array)[count])
+        count++;
+    *array = realloc(*array, (count + 2) * sizeof(char *));
+    (*array)[count] = arg;
+    (*array)[count + 1] = NULL;
+}
+
 const pos_arg_t POS_ARGS[] = {
-    { set_str, "Error: No MP3 file provided"}
+    /* the last positional argument takes all the rest, there may be none when only querying a catalog */
+    { add_str, NULL }
 };
 
 const switch_t SWITCHES[] = {
 	{ 'g', "get", true, set_str },
 	{ 's', "set", true, set_str },
     { 'R', "rewrite", false, set_switch },
-    { 'x', "extract-pictures", false, set_switch }
+    { 'x', "extract-pictures", false, set_switch },
+    { 'z', "compress", false, set_switch },
+    { 'j', "jobs", true, set_int },
+    { 'C', "catalog", true, set_str },
+    { 'q', "query", true, set_str }
 };
\ No newline at end of file
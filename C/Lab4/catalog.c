@@ -0,0 +1,190 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <iso646.h>
+#include "catalog.h"
+
+#define CATALOG_SIGNATURE "ID3CAT01"
+#define LEN(arr) (sizeof(arr) / sizeof(arr[0]))
+
+int compare_entries(const void *a, const void *b, void *strings) {
+    const struct catalog_entry *x = a, *y = b;
+    return strcmp((char *)strings + x->path, (char *)strings + y->path);
+}
+
+/* grows an array of count items to hold one more */
+void *reserve(void *array, size_t count, size_t *capacity, size_t item_size) {
+    if (count < *capacity)
+        return array;
+    *capacity = *capacity ? *capacity * 2 : 64;
+    return realloc(array, *capacity * item_size);
+}
+
+/* appends a string with its terminating zero and returns its offset */
+unsigned long long add_string(struct catalog *catalog, const char *str, size_t length) {
+    unsigned long long offset = catalog->strings_size;
+    while (catalog->strings_size + length + 1 > catalog->strings_capacity)
+        catalog->strings = reserve(catalog->strings, catalog->strings_capacity, &catalog->strings_capacity, 1);
+    memcpy(catalog->strings + offset, str, length);
+    catalog->strings[offset + length] = '\0';
+    catalog->strings_size += length + 1;
+    return offset;
+}
+
+/* sorts the entries by path, which catalog_find relies on */
+void catalog_sort(struct catalog *catalog) {
+    qsort_r(catalog->entries, catalog->count, sizeof(struct catalog_entry), compare_entries, catalog->strings);
+}
+
+/* every path and value lies in the strings and ends there, every entry owns frames that exist */
+bool catalog_valid(const struct catalog *catalog) {
+    if (catalog->strings_size > 0 and catalog->strings[catalog->strings_size - 1] != '\0')
+        return false;
+    for (const struct catalog_entry *entry = catalog->entries; entry < catalog->entries + catalog->count; entry++) {
+        if (entry->path >= catalog->strings_size or entry->first_frame > catalog->frame_count
+                or entry->frame_count > catalog->frame_count - entry->first_frame)
+            return false;
+    }
+    for (const struct catalog_frame *frame = catalog->frames; frame < catalog->frames + catalog->frame_count; frame++) {
+        if (frame->value >= catalog->strings_size or frame->length > catalog->strings_size - frame->value - 1
+                or catalog->strings[frame->value + frame->length] != '\0')
+            return false;
+    }
+    return true;
+}
+
+/* a missing catalog file is an empty catalog, a foreign or damaged one is an error */
+int catalog_load(const char *filename, struct catalog *catalog) {
+    char signature[LEN(CATALOG_SIGNATURE)];
+    unsigned long long counts[3];
+    struct stat info;
+    FILE *file = fopen(filename, "rb");
+
+    memset(catalog, 0, sizeof *catalog);
+    if (file == NULL)
+        return 0;
+
+    /* the counts must describe exactly the bytes that follow them */
+    if (fstat(fileno(file), &info) != 0 or
+            fread(signature, 1, LEN(signature), file) != LEN(signature) or
+            memcmp(signature, CATALOG_SIGNATURE, LEN(signature)) != 0 or
+            fread(counts, sizeof counts, 1, file) != 1 or
+            counts[0] > (unsigned long long)info.st_size / sizeof(struct catalog_entry) or
+            counts[1] > (unsigned long long)info.st_size / sizeof(struct catalog_frame) or
+            counts[2] > (unsigned long long)info.st_size or
+            LEN(signature) + sizeof counts + counts[0] * sizeof(struct catalog_entry) +
+                counts[1] * sizeof(struct catalog_frame) + counts[2] != (unsigned long long)info.st_size) {
+        fclose(file);
+        return 1;
+    }
+    catalog->capacity = catalog->count = counts[0];
+    catalog->frame_capacity = catalog->frame_count = counts[1];
+    catalog->strings_capacity = catalog->strings_size = counts[2];
+    catalog->entries = malloc(counts[0] * sizeof(struct catalog_entry));
+    catalog->frames = malloc(counts[1] * sizeof(struct catalog_frame));
+    catalog->strings = malloc(counts[2]);
+    if (fread(catalog->entries, sizeof(struct catalog_entry), counts[0], file) != counts[0] or
+            fread(catalog->frames, sizeof(struct catalog_frame), counts[1], file) != counts[1] or
+            fread(catalog->strings, 1, counts[2], file) != counts[2] or not catalog_valid(catalog)) {
+        fclose(file);
+        catalog_free(catalog);
+        return 1;
+    }
+    fclose(file);
+    /* entries are saved sorted, this only guards against hand-edited files */
+    catalog_sort(catalog);
+    return 0;
+}
+
+/* entries are sorted by path, the file is written next to the catalog and renamed over it */
+int catalog_save(const char *filename, struct catalog *catalog) {
+    char temp[strlen(filename) + 5];
+    unsigned long long counts[3] = { catalog->count, catalog->frame_count, catalog->strings_size };
+    FILE *file;
+
+    catalog_sort(catalog);
+    sprintf(temp, "%s.tmp", filename);
+    file = fopen(temp, "wb");
+    if (file == NULL)
+        return 1;
+    fwrite(CATALOG_SIGNATURE, 1, LEN(CATALOG_SIGNATURE), file);
+    fwrite(counts, sizeof counts, 1, file);
+    fwrite(catalog->entries, sizeof(struct catalog_entry), catalog->count, file);
+    fwrite(catalog->frames, sizeof(struct catalog_frame), catalog->frame_count, file);
+    fwrite(catalog->strings, 1, catalog->strings_size, file);
+    if (fclose(file) != 0 or rename(temp, filename) != 0) {
+        remove(temp);
+        return 1;
+    }
+    return 0;
+}
+
+void catalog_free(struct catalog *catalog) {
+    free(catalog->entries);
+    free(catalog->frames);
+    free(catalog->strings);
+    memset(catalog, 0, sizeof *catalog);
+}
+
+/* entries of a loaded or sorted catalog are sorted, the ones added since are not looked at */
+const struct catalog_entry *catalog_find(const struct catalog *catalog, const char *path) {
+    size_t low = 0, high = catalog->count;
+    while (low < high) {
+        size_t middle = (low + high) / 2;
+        int order = strcmp(catalog->strings + catalog->entries[middle].path, path);
+        if (order == 0)
+            return &catalog->entries[middle];
+        if (order < 0)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    return NULL;
+}
+
+/* the file has not been changed since its frames were read */
+bool catalog_fresh(const struct catalog_entry *entry, const struct stat *info) {
+    return entry->size == (unsigned long long)info->st_size and entry->mtime_sec == info->st_mtim.tv_sec
+        and entry->mtime_nsec == info->st_mtim.tv_nsec;
+}
+
+/* starts an entry, the frames added next belong to it */
+void catalog_add(struct catalog *catalog, const char *path, const struct stat *info) {
+    catalog->entries = reserve(catalog->entries, catalog->count, &catalog->capacity, sizeof(struct catalog_entry));
+    catalog->entries[catalog->count++] = (struct catalog_entry) {
+        info->st_size, info->st_mtim.tv_sec, info->st_mtim.tv_nsec,
+        add_string(catalog, path, strlen(path)), catalog->frame_count, 0
+    };
+}
+
+void catalog_add_frame(struct catalog *catalog, const char id[4], const char *value) {
+    struct catalog_frame frame = { .length = strlen(value) };
+    memcpy(frame.id, id, 4);
+    frame.value = add_string(catalog, value, frame.length);
+    catalog->frames = reserve(catalog->frames, catalog->frame_count, &catalog->frame_capacity,
+        sizeof(struct catalog_frame));
+    catalog->frames[catalog->frame_count++] = frame;
+    catalog->entries[catalog->count - 1].frame_count++;
+}
+
+/* adds an entry of another catalog with all its frames */
+void catalog_copy(struct catalog *to, const struct catalog *from, const struct catalog_entry *entry) {
+    struct stat info;
+    info.st_size = entry->size;
+    info.st_mtim.tv_sec = entry->mtime_sec;
+    info.st_mtim.tv_nsec = entry->mtime_nsec;
+    catalog_add(to, catalog_path(from, entry), &info);
+    for (unsigned long long i = 0; i < entry->frame_count; i++) {
+        const struct catalog_frame *frame = &from->frames[entry->first_frame + i];
+        catalog_add_frame(to, frame->id, catalog_value(from, frame));
+    }
+}
+
+const char *catalog_path(const struct catalog *catalog, const struct catalog_entry *entry) {
+    return catalog->strings + entry->path;
+}
+
+const char *catalog_value(const struct catalog *catalog, const struct catalog_frame *frame) {
+    return catalog->strings + frame->value;
+}
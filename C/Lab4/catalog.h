@@ -0,0 +1,50 @@
+#ifndef CATALOG_INCLUDED
+#define CATALOG_INCLUDED
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/stat.h>
+
+/*
+ * text frames of many files, saved in one binary file: an entry per file,
+ * the frames of all files and one pool of the strings they point to
+ */
+struct catalog_entry {
+    /* size and modification time of the file when its frames were read */
+    unsigned long long size;
+    long long mtime_sec, mtime_nsec;
+    /* offset of the path in the strings */
+    unsigned long long path;
+    unsigned long long first_frame;
+    unsigned long long frame_count;
+};
+
+struct catalog_frame {
+    char id[4];
+    unsigned length;
+    /* offset of the value in the strings */
+    unsigned long long value;
+};
+
+struct catalog {
+    struct catalog_entry *entries;
+    size_t count, capacity;
+    struct catalog_frame *frames;
+    size_t frame_count, frame_capacity;
+    char *strings;
+    size_t strings_size, strings_capacity;
+};
+
+int catalog_load(const char *filename, struct catalog *catalog);
+int catalog_save(const char *filename, struct catalog *catalog);
+void catalog_free(struct catalog *catalog);
+void catalog_sort(struct catalog *catalog);
+const struct catalog_entry *catalog_find(const struct catalog *catalog, const char *path);
+bool catalog_fresh(const struct catalog_entry *entry, const struct stat *info);
+void catalog_add(struct catalog *catalog, const char *path, const struct stat *info);
+void catalog_add_frame(struct catalog *catalog, const char id[4], const char *value);
+void catalog_copy(struct catalog *to, const struct catalog *from, const struct catalog_entry *entry);
+const char *catalog_path(const struct catalog *catalog, const struct catalog_entry *entry);
+const char *catalog_value(const struct catalog *catalog, const struct catalog_frame *frame);
+
+#endif
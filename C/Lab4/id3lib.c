@@ -1,66 +1,144 @@
+#define _GNU_SOURCE
 #include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 #include <iso646.h>
 #include <stdbool.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <zlib.h>
 #include "id3lib.h"
 
-bool has_frame(char id[4], struct id3tag *tag) {
-    struct frame_list *list = tag->first;
-    while (memcmp(list->frame.id, id, 4) != 0 or list != NULL) {
-        list = list->next;
-    }
+#define COPY_BUFFER_SIZE (1 << 20)
+/* stored frame bytes go through a buffer of this size when they are decoded or encoded */
+#define CODING_BUFFER_SIZE 4096
 
-    return list == NULL;
+/* the id read as a number, hashed with Fibonacci hashing */
+unsigned frame_hash(const char id[4], int index_size) {
+    uint32_t key;
+    memcpy(&key, id, 4);
+    return (key * 2654435769u) & (index_size - 1);
 }
 
-struct frame *get_frame(char id[4], struct id3tag *tag) {
-    struct frame_list *list = tag->first;
-    while (list != NULL) {
-        if (memcmp(list->frame.id, id, 4) == 0)
-            break;
-        list = list->next;
+/* the index slot that holds the first frame with the id, or the empty slot where it would go */
+int *index_slot(const char id[4], struct id3tag *tag) {
+    unsigned slot = frame_hash(id, tag->index_size);
+    while (tag->index[slot] >= 0 and memcmp(tag->frames[tag->index[slot]].id, id, 4) != 0)
+        slot = (slot + 1) & (tag->index_size - 1);
+    return &tag->index[slot];
+}
+
+/* links every frame into its chain again, the index is kept at most half full */
+void rebuild_index(struct id3tag *tag) {
+    int *last = malloc(tag->frame_count * sizeof(int));
+    if (tag->index_size < 2 * tag->frame_count or tag->index_size == 0) {
+        tag->index_size = tag->index_size ? tag->index_size : FRAME_INDEX_SIZE;
+        while (tag->index_size < 2 * tag->frame_count)
+            tag->index_size *= 2;
+        tag->index = realloc(tag->index, tag->index_size * sizeof(int));
+    }
+    memset(tag->index, -1, tag->index_size * sizeof(int));
+    for (int i = 0; i < tag->frame_count; ++i) {
+        int *slot = index_slot(tag->frames[i].id, tag);
+        tag->frames[i].next = -1;
+        if (*slot < 0)
+            *slot = i;
+        else
+            tag->frames[last[*slot]].next = i;
+        last[*slot] = i;
     }
+    free(last);
+}
+
+bool has_frame(char id[4], struct id3tag *tag) {
+    return get_frame(id, tag) != NULL;
+}
 
-    return list == NULL ? NULL : &list->frame;
+/* the first frame with the id in file order */
+struct frame *get_frame(char id[4], struct id3tag *tag) {
+    int first;
+    if (tag->index_size == 0)
+        return NULL;
+    first = *index_slot(id, tag);
+    return first < 0 ? NULL : &tag->frames[first];
 }
 
-void put_frame(struct frame value, struct id3tag *tag) {
-    struct frame_list *new_node = malloc(sizeof(struct frame_list));
-    memcpy(&new_node->frame, &value, sizeof(struct frame));
-    new_node->next = tag->first;
-    tag->first = new_node;
+/* the next frame with the same id, for frames like COMM that may appear several times */
+struct frame *next_frame(struct frame *frame, struct id3tag *tag) {
+    return frame->next < 0 ? NULL : &tag->frames[frame->next];
 }
 
-void remove_frame(char id[4], struct id3tag *tag) {
-    struct frame_list *to_remove, **helper = &tag->first;
-    while (*helper != NULL or memcmp(id, (*helper)->frame.id, 4)) {
-        helper = &(*helper)->next;
+/* appends a frame, the tag takes over its data */
+void put_frame(struct frame value, struct id3tag *tag) {
+    if (tag->frame_count == tag->frame_capacity) {
+        tag->frame_capacity = tag->frame_capacity ? 2 * tag->frame_capacity : FRAME_INDEX_SIZE / 2;
+        tag->frames = realloc(tag->frames, tag->frame_capacity * sizeof(struct frame));
+    }
+    value.next = -1;
+    tag->frames[tag->frame_count++] = value;
+    if (tag->index_size < 2 * tag->frame_count) {
+        rebuild_index(tag);
+        return;
     }
 
-    if (*helper == NULL)
+    int *slot = index_slot(value.id, tag);
+    if (*slot < 0) {
+        *slot = tag->frame_count - 1;
         return;
+    }
+    struct frame *last = &tag->frames[*slot];
+    while (last->next >= 0)
+        last = &tag->frames[last->next];
+    last->next = tag->frame_count - 1;
+}
 
-    to_remove = *helper;
-    *helper = (*helper)->next;
-    free(to_remove);
+void release_frame(struct frame *frame) {
+    free(frame->data);
+    if (frame->source_size)
+        close(frame->source);
+}
+
+/* removes every frame with the id */
+void remove_frame(char id[4], struct id3tag *tag) {
+    int kept = 0;
+    if (get_frame(id, tag) == NULL)
+        return;
+    for (int i = 0; i < tag->frame_count; ++i) {
+        if (memcmp(tag->frames[i].id, id, 4) == 0)
+            release_frame(&tag->frames[i]);
+        else
+            tag->frames[kept++] = tag->frames[i];
+    }
+    tag->frame_count = kept;
+    rebuild_index(tag);
 }
 
 void free_id3v2_tag(struct id3tag *tag) {
-    /* deleting frame list */
-    {
-        struct frame_list *tmp;
-        while (tag->first != NULL) {
-            tmp = tag->first;
-            tag->first = tag->first->next;
-            free(tmp);
-        }
+    for (int i = 0; i < tag->frame_count; ++i) {
+        release_frame(&tag->frames[i]);
     }
+    free(tag->frames);
+    free(tag->index);
     free(tag->extended_header);
+    if (tag->map != NULL and tag->mapped)
+        munmap(tag->map, tag->map_size);
+    else
+        free(tag->map);
+    tag->map = NULL;
+    tag->frames = NULL;
+    tag->frame_count = tag->frame_capacity = 0;
+    tag->index = NULL;
+    tag->index_size = 0;
+    tag->extended_header = NULL;
 }
 
-int from_synchsafe32(unsigned char safe[4]) {
+int from_synchsafe32(const unsigned char safe[4]) {
     return safe[0] << 21 | safe[1] << 14 | safe[2] << 7 | safe[3];
 }
 
@@ -71,16 +149,28 @@ void to_synchsafe32(int value, char *buf) {
     buf[0] = value >> 21 & SYNCHSAFE_MASK;
 }
 
-/* reads 4-byte synchsafe integer from a file */
-int read_int(FILE *file, struct id3tag *tag) {
-    unsigned char buffer[4];
-    fread(buffer, 1, 4, file);
+/* 4-byte integer, synchsafe since ID3v2.4 */
+int to_int(const unsigned char buffer[4], struct id3tag *tag) {
     if (tag->version[0] == 4) {
         return from_synchsafe32(buffer);
     }
     return buffer[0] << 24 | buffer[1] << 16 | buffer[2] << 8 | buffer[3];
 }
 
+/* reads 4-byte integer from a file, synchsafe since ID3v2.4 */
+int read_int(FILE *file, struct id3tag *tag) {
+    unsigned char buffer[4];
+    fread(buffer, 1, 4, file);
+    return to_int(buffer, tag);
+}
+
+/* reads 4-byte synchsafe integer from a file */
+int read_synchsafe32(FILE *file) {
+    unsigned char buffer[4];
+    fread(buffer, 1, 4, file);
+    return from_synchsafe32(buffer);
+}
+
 /* writes 4-byte synchsafe integer to a file */
 void write_synchsafe32(FILE *file, int value) {
     char safe[4];
@@ -88,24 +178,56 @@ void write_synchsafe32(FILE *file, int value) {
     fwrite(safe, 1, 4, file);
 }
 
-/* returns tag offset counting from start of a file */
+/* a header or footer with the given identifier, a known version and a synchsafe size */
+bool is_tag_header(const unsigned char *header, const char *identifier) {
+    return memcmp(header, identifier, 3) == 0 and header[3] != 0xff and header[4] != 0xff
+        and (header[6] | header[7] | header[8] | header[9]) < 0x80;
+}
+
+/*
+ * returns tag offset counting from start of a file, only the start of the file
+ * and the footer in front of an ID3v1 block or at the very end are looked at
+ */
 int search_id3_identifier(FILE *audio_file) {
-    char id[4], ver[2];
-    id[3] = '\0';
-    fread(id, sizeof(char), 3, audio_file);
-    while (strcmp(id, ID3_IDENTIFIER) != 0 and !feof(audio_file))
-    {
-        id[1] = id[0];
-        id[2] = id[1];
-        id[2] = fgetc(audio_file);
+    unsigned char buffer[SEARCH_WINDOW], *found = NULL, *header = NULL;
+    size_t read_size;
+    long offset = -1;
+
+    rewind(audio_file);
+    read_size = fread(buffer, 1, sizeof(buffer), audio_file);
+    for (unsigned char *from = buffer; offset < 0 and read_size >= 10
+            and (found = memmem(from, buffer + read_size - from - 2, ID3_IDENTIFIER, 3)); from = found + 1) {
+        /* the whole header must be in the buffer, a tag may end right with it */
+        if (found + 10 <= buffer + read_size and is_tag_header(found, ID3_IDENTIFIER))
+            offset = (header = found) - buffer;
     }
-    if (feof(audio_file)) {
+
+    /* an appended ID3v2.4 tag ends with a footer */
+    if (offset < 0 and fseek(audio_file, -(ID3V1_SIZE + 10), SEEK_END) == 0
+            and fread(buffer, 1, ID3V1_SIZE + 10, audio_file) == ID3V1_SIZE + 10) {
+        long footer = ftell(audio_file) - 10;
+        unsigned char *at = buffer + ID3V1_SIZE;
+        if (memcmp(buffer + 10, ID3V1_IDENTIFIER, 3) == 0) {
+            footer -= ID3V1_SIZE;
+            at = buffer;
+        }
+        if (is_tag_header(at, ID3_BACK_IDENTIFIER)) {
+            offset = footer - from_synchsafe32(at + 6) - 10;
+            if (offset < 0 or fseek(audio_file, offset, SEEK_SET) != 0
+                    or fread(buffer, 1, 10, audio_file) != 10 or not is_tag_header(buffer, ID3_IDENTIFIER))
+                offset = -1;
+            header = buffer;
+        }
+    }
+
+    if (offset < 0) {
         return -TAG_NOT_FOUND;
     }
-    fread(ver, sizeof(char), sizeof(ver), audio_file);
-    if (ver[0] > ID3V2_VERSION)
+    /* the header is read from right after the identifier and version */
+    fseek(audio_file, offset + 5, SEEK_SET);
+    if (header[3] > ID3V2_VERSION)
         return -TAG_TOO_BIG_VERSION;
-    return ftell(audio_file) - 5;
+    return offset;
 }
 
 int read_tag_header(FILE *audio_file, struct id3tag *tag) {
@@ -116,8 +238,8 @@ int read_tag_header(FILE *audio_file, struct id3tag *tag) {
     fread(tag->version, 1, 2, audio_file);
     tag->flags = fgetc(audio_file);
 
-    /* reading tag flags */
-    tag->size = read_int(audio_file, tag);
+    /* the tag size is synchsafe in every version, frame sizes only since ID3v2.4 */
+    tag->size = read_synchsafe32(audio_file);
     if (tag->flags & EXTENDED_HEADER_BIT) {
         tag->extended_header_size = read_int(audio_file, tag);
         tag->extended_header = tag->extended_header_size > 0 ? malloc(tag->extended_header_size) : NULL;
@@ -145,114 +267,488 @@ int read_tag_header(FILE *audio_file, struct id3tag *tag) {
     return tag->offset;
 }
 
-int read_id3v2_tag(FILE *audio_file, struct id3tag *result) {
+/* the payload as it is stored, in memory once changed and in the mapped tag until then */
+void *stored_data(struct frame *frame, struct id3tag *tag) {
+    return frame->data ? frame->data : tag->map + (frame->offset - tag->map_start);
+}
+
+/* reads unsynchronised bytes without the zeros inserted after 0xff */
+struct unsync_reader {
+    const unsigned char *next, *end;
+    bool unsync;
+};
+
+size_t unsync_read(struct unsync_reader *reader, unsigned char *out, size_t size) {
+    size_t count = 0;
+    while (count < size and reader->next < reader->end) {
+        unsigned char c = *reader->next++;
+        out[count++] = c;
+        if (c == 0xff and reader->unsync and reader->next < reader->end and *reader->next == 0)
+            reader->next++;
+    }
+    return count;
+}
+
+/*
+ * undoes unsynchronisation and compression in one pass: the stored bytes go through
+ * a fixed buffer into inflate, which writes straight into the decoded payload
+ */
+void decode_frame(struct frame *frame, struct id3tag *tag) {
+    struct unsync_reader reader = { stored_data(frame, tag), NULL, frame->flags[1] & UNSYCHRONISATION_BIT };
+    unsigned char prefix[5], buffer[CODING_BUFFER_SIZE], *decoded;
+    size_t group = frame->flags[1] & GROUP_BIT ? 1 : 0, length = frame->size;
+    bool has_length = frame->flags[1] & DATA_LENGTH_INDICATOR_BIT;
+    reader.end = reader.next + frame->size;
+
+    /* the group id comes before the data length in ID3v2.4 and after it in ID3v2.3 */
+    if (unsync_read(&reader, prefix, group + 4 * has_length) != group + 4 * has_length)
+        return;
+    if (has_length)
+        length = to_int(prefix + (tag->version[0] == 4 ? group : 0), tag);
+    if (frame->flags[1] & COMPRESSION_BIT and not has_length)
+        return;
+    if ((decoded = malloc(group + length)) == NULL)
+        return;
+    if (group)
+        decoded[0] = prefix[tag->version[0] == 4 ? 0 : 4 * has_length];
+
+    if (frame->flags[1] & COMPRESSION_BIT) {
+        z_stream stream = { .next_out = decoded + group, .avail_out = length };
+        int status = inflateInit(&stream);
+        while (status == Z_OK and (stream.avail_in = unsync_read(&reader, buffer, sizeof(buffer))) > 0) {
+            stream.next_in = buffer;
+            status = inflate(&stream, Z_NO_FLUSH);
+        }
+        inflateEnd(&stream);
+        if (status != Z_STREAM_END or stream.avail_out != 0) {
+            free(decoded);
+            return;
+        }
+    }
+    else {
+        length = unsync_read(&reader, decoded + group, length);
+    }
+    free(frame->data);
+    frame->data = decoded;
+    frame->size = group + length;
+    frame->flags[1] &= ~(COMPRESSION_BIT | UNSYCHRONISATION_BIT | DATA_LENGTH_INDICATOR_BIT);
+}
+
+/* reads the part of the payload left in the source file, what cannot be read is zeros */
+void read_source(struct frame *frame) {
+    unsigned kept = frame->size - frame->source_size;
+    char *data = realloc(frame->data, frame->size);
+    ssize_t read_size;
+    if (data == NULL)
+        return;
+    read_size = pread(frame->source, data + kept, frame->source_size, frame->source_offset);
+    if (read_size < 0)
+        read_size = 0;
+    memset(data + kept + read_size, 0, frame->source_size - read_size);
+    close(frame->source);
+    frame->data = data;
+    frame->source_size = 0;
+}
+
+/* the payload of a frame, decoded on the first access if it is unsynchronised or compressed */
+void *frame_data(struct frame *frame, struct id3tag *tag) {
+    if (frame->source_size)
+        read_source(frame);
+    if (frame->flags[1] & (COMPRESSION_BIT | UNSYCHRONISATION_BIT) and not (frame->flags[1] & ENCRYPTION_BIT))
+        decode_frame(frame, tag);
+    return stored_data(frame, tag);
+}
 
+/* deflates frames of at least min_size bytes when that makes them smaller */
+void compress_frames(struct id3tag *tag, unsigned min_size) {
+    for (struct frame *frame = tag->frames; frame < tag->frames + tag->frame_count; ++frame) {
+        /* ID3v2.3 compressed frames are decoded since their data length is written differently */
+        if (frame->flags[1] & (ENCRYPTION_BIT | GROUP_BIT) or (frame->flags[1] & COMPRESSION_BIT and tag->version[0] == 4))
+            continue;
+        /* pictures are already compressed and are left in their files */
+        if (frame->source_size)
+            continue;
+        const unsigned char *data = frame_data(frame, tag);
+        if (frame->size < min_size or frame->flags[1] & (COMPRESSION_BIT | UNSYCHRONISATION_BIT))
+            continue;
+        uLongf packed_size = compressBound(frame->size);
+        unsigned char *packed = malloc(4 + packed_size);
+        if (packed != NULL
+                and compress2(packed + 4, &packed_size, data, frame->size, Z_BEST_COMPRESSION) == Z_OK
+                and 4 + packed_size < frame->size) {
+            /* the data length indicator holds the size before compression */
+            to_synchsafe32(frame->size, (char *)packed);
+            free(frame->data);
+            frame->data = packed;
+            frame->size = 4 + packed_size;
+            frame->flags[1] |= COMPRESSION_BIT | DATA_LENGTH_INDICATOR_BIT;
+        }
+        else {
+            free(packed);
+        }
+    }
+}
+
+/* the number of bytes unsynchronisation turns data into */
+unsigned unsync_size(const unsigned char *data, unsigned size) {
+    unsigned result = size;
+    for (unsigned i = 0; i < size; ++i) {
+        if (data[i] == 0xff and (i + 1 == size or data[i + 1] == 0 or data[i + 1] >= 0xe0))
+            result++;
+    }
+    return result;
+}
+
+/* writes data unsynchronised through a fixed buffer */
+void write_unsync(FILE *file, const unsigned char *data, unsigned size) {
+    unsigned char buffer[CODING_BUFFER_SIZE];
+    size_t used = 0;
+    for (unsigned i = 0; i < size; ++i) {
+        buffer[used++] = data[i];
+        if (data[i] == 0xff and (i + 1 == size or data[i + 1] == 0 or data[i + 1] >= 0xe0))
+            buffer[used++] = 0;
+        if (used >= sizeof(buffer) - 1) {
+            fwrite(buffer, 1, used, file);
+            used = 0;
+        }
+    }
+    fwrite(buffer, 1, used, file);
+}
+
+/* frames of an unsynchronised tag are unsynchronised when written unless they already are */
+bool unsync_on_write(struct frame *frame, struct id3tag *tag) {
+    return tag->flags & UNSYNCHRONISATION_BIT and not (frame->flags[1] & UNSYCHRONISATION_BIT);
+}
+
+unsigned written_size(struct frame *frame, struct id3tag *tag) {
+    return unsync_on_write(frame, tag) ? unsync_size(stored_data(frame, tag), frame->size) : frame->size;
+}
+
+/*
+ * maps the file up to the end of the tag, only frame headers are parsed and
+ * payloads stay in the mapping until they are accessed or changed, the mapping
+ * is shared so that it follows a tag updated in place
+ */
+int read_id3v2_tag(FILE *audio_file, struct id3tag *result) {
+    struct stat st;
+    result->frames = NULL;
+    result->frame_count = result->frame_capacity = 0;
+    result->index = NULL;
+    result->index_size = 0;
+    result->map = NULL;
+    result->map_size = 0;
     if (read_tag_header(audio_file, result) < 0) {
         return -result->offset;
     }
-    result->first = NULL;
-    /* reading frames */
-    {
-        struct frame read;
-        do
-        {
-            fread(&read.id, 1, 4, audio_file);
-            if (result->extended_flags & IS_UPDATE_BIT) {
-                struct frame *frame = get_frame(read.id, result);
-                read.size = read_int(audio_file, result);
-                fread(&read.flags, sizeof(char), sizeof(read.flags), audio_file);
-                fread(&read.flags, sizeof(char), sizeof(read.flags), audio_file);
-                read.data = realloc(read.data, read.size);
-                if (frame != NULL) {
-                    free(frame->data);
-                    frame->data = read.data;
-                }
-            }
-            else {
-                read.size = read_int(audio_file, result);
-                fread(&read.flags, sizeof(char), sizeof(read.flags), audio_file);
-                read.data = malloc(read.size);
-                fread(read.data, sizeof(char), read.size, audio_file);
-            }
-            if (memcmp(read.id, "\0\0\0\0", 4) != 0)
-                put_frame(read, result);
-            /* keep reading until reaching padding or end of a tag */
-        } while (memcmp(read.id, "\0\0\0\0", 4) != 0 and
-                ftell(audio_file) - result->offset <= result->size);
+    long position = ftell(audio_file), end = result->offset + 10 + result->size;
+    /* before ID3v2.4 unsynchronisation covers the frame headers too, such a tag is decoded into memory */
+    bool whole_tag_unsync = result->version[0] < 4 and result->flags & UNSYNCHRONISATION_BIT;
+
+    result->mapped = not whole_tag_unsync and fstat(fileno(audio_file), &st) == 0 and S_ISREG(st.st_mode)
+        and st.st_size >= end
+        and (result->map = mmap(NULL, end, PROT_READ, MAP_SHARED, fileno(audio_file), 0)) != MAP_FAILED;
+    if (result->map == MAP_FAILED)
+        result->map = NULL;
+    if (result->mapped) {
+        result->map_start = 0;
+        result->map_size = end;
+    }
+    else if (whole_tag_unsync) {
+        unsigned char buffer[CODING_BUFFER_SIZE];
+        size_t remaining = end - position, kept = 0, read_size;
+        result->map = malloc(remaining);
+        result->map_start = position;
+        result->map_size = 0;
+        /* a 0xff ending a buffer is kept for the next one, which may start with the zero after it */
+        while (remaining > 0 and (read_size = fread(buffer + kept, 1,
+                remaining < sizeof(buffer) - kept ? remaining : sizeof(buffer) - kept, audio_file)) > 0) {
+            struct unsync_reader reader = { buffer, buffer + kept + read_size, true };
+            remaining -= read_size;
+            kept = remaining > 0 and reader.end[-1] == 0xff;
+            reader.end -= kept;
+            result->map_size += unsync_read(&reader, (unsigned char *)result->map + result->map_size, sizeof(buffer));
+            buffer[0] = 0xff;
+        }
+        end = position + result->map_size;
+    }
+    else {
+        /* pipes and truncated files: the rest of the tag is read into memory */
+        result->map = malloc(end - position);
+        result->map_start = position;
+        result->map_size = fread(result->map, 1, end - position, audio_file);
+        end = position + result->map_size;
+    }
+
+    /* reading frames until reaching padding or end of a tag */
+    struct frame read = { .source_size = 0 };
+    while (position + 10 <= end) {
+        const unsigned char *header = (unsigned char *)result->map + (position - result->map_start);
+        if (header[0] == 0)
+            break;
+        memcpy(read.id, header, 4);
+        read.size = to_int(header + 4, result);
+        memcpy(read.flags, header + 8, 2);
+        if (result->version[0] < 4) {
+            /* ID3v2.3 keeps the status and format flags in other bits */
+            char status = read.flags[0], format = read.flags[1];
+            read.flags[0] = (status & 0x80 ? ALTERED_BIT : 0) | (status & 0x40 ? FILE_ALTERED_BIT : 0)
+                | (status & 0x20 ? READONLY_BIT : 0);
+            read.flags[1] = (format & 0x80 ? COMPRESSION_BIT | DATA_LENGTH_INDICATOR_BIT : 0)
+                | (format & 0x40 ? ENCRYPTION_BIT : 0) | (format & 0x20 ? GROUP_BIT : 0);
+        }
+        position += 10;
+        if (read.size > end - position)
+            break;
+        read.data = NULL;
+        read.offset = position;
+        position += read.size;
+        /* frames of an update replace the ones with the same id */
+        struct frame *present = result->extended_flags & IS_UPDATE_BIT ? get_frame(read.id, result) : NULL;
+        if (present != NULL) {
+            free(present->data);
+            present->size = read.size;
+            memcpy(present->flags, read.flags, 2);
+            present->data = NULL;
+            present->offset = read.offset;
+        }
+        else {
+            put_frame(read, result);
+        }
     }
     return 0;
 }
 
-void prepend_new_tag(FILE *audio_file, struct id3tag *tag) {
-    int frames_size = 0;
-    rewind(audio_file);
-    /* writing header */
-    fwrite("ID3", 3, 1, audio_file);
-    fputc(ID3V2_VERSION, audio_file);
-    fputc(ID3V2_REVISION, audio_file);
-    fputc(tag->flags, audio_file);
-    write_synchsafe32(audio_file, tag->size);
-    /* maybe i should write extended header here... */
+/* size of the frames once written, without padding */
+unsigned frames_size(struct id3tag *tag) {
+    unsigned size = 0;
+    for (int i = 0; i < tag->frame_count; ++i) {
+        size += 10 + written_size(&tag->frames[i], tag);
+    }
+    return size;
+}
 
-    /* writing tags */
-    struct frame_list *list = tag->first;
-    while (list != NULL) {
-        fwrite(list->frame.id, 1, 4, audio_file);
-        write_synchsafe32(audio_file, list->frame.size);
-        fwrite(list->frame.flags, 1, 2, audio_file);
-        fwrite(list->frame.data, 1, list->frame.size, audio_file);
-        frames_size += 10 + list->frame.size;
-        list = list->next;
+/* copies length bytes or up to the end of in to out, inside the kernel when it can */
+int copy_range(int in, int out, off_t length) {
+    ssize_t copied = 0;
+    while (length > 0 and (copied = copy_file_range(in, NULL, out, NULL,
+            length < COPY_BUFFER_SIZE ? length : COPY_BUFFER_SIZE, 0)) > 0)
+        length -= copied;
+    if (length == 0 or copied == 0)
+        return 0;
+    if (errno != EXDEV and errno != EINVAL and errno != ENOSYS and errno != EOPNOTSUPP)
+        return -1;
+
+    /* other file systems or old kernels: both offsets are where the kernel stopped */
+    char *buffer = malloc(COPY_BUFFER_SIZE);
+    ssize_t read_size = 0;
+    if (buffer == NULL)
+        return -1;
+    while (length > 0 and (read_size = read(in, buffer,
+            length < COPY_BUFFER_SIZE ? length : COPY_BUFFER_SIZE)) > 0) {
+        for (ssize_t written = 0, n; written < read_size; written += n) {
+            if ((n = write(out, buffer + written, read_size - written)) < 0) {
+                free(buffer);
+                return -1;
+            }
+        }
+        length -= read_size;
     }
+    free(buffer);
+    return read_size < 0 ? -1 : 0;
+}
 
-    for (int i = 0; i < tag->size - frames_size; ++i) {
-        fputc(0, audio_file);
+/* writes the frame header and the payload in memory at once, the rest of the payload goes from its file to the output */
+int write_source_frame(int out, char header[10], struct frame *frame) {
+    struct iovec parts[2] = { { header, 10 }, { frame->data, frame->size - frame->source_size } };
+    size_t left = parts[0].iov_len + parts[1].iov_len;
+    ssize_t written;
+    while (left > 0 and (written = writev(out, parts, 2)) > 0) {
+        left -= written;
+        for (struct iovec *part = parts; part < parts + 2; ++part) {
+            size_t done = (size_t)written < part->iov_len ? (size_t)written : part->iov_len;
+            part->iov_base = (char *)part->iov_base + done;
+            part->iov_len -= done;
+            written -= done;
+        }
     }
+    if (left > 0 or lseek(frame->source, frame->source_offset, SEEK_SET) < 0
+            or copy_range(frame->source, out, frame->source_size) != 0)
+        return -1;
+    /* a source that got shorter would leave the tag shorter than its header says */
+    return lseek(frame->source, 0, SEEK_CUR) == frame->source_offset + frame->source_size ? 0 : -1;
 }
 
+void write_tag_header(FILE *file, const char *identifier, char flags, unsigned size) {
+    fwrite(identifier, 3, 1, file);
+    fputc(ID3V2_VERSION, file);
+    fputc(ID3V2_REVISION, file);
+    fputc(flags, file);
+    write_synchsafe32(file, size);
+}
 
-void write_id3v2_tag(char *filename, struct id3tag *tag) {
-    FILE *audio_file = fopen(filename, "r+b");
-    FILE *temp = tmpfile();
-    int offset = search_id3_identifier(audio_file), size;
-    fseek(audio_file, 1, SEEK_CUR);
-    size = read_int(audio_file, tag);
-    fseek(audio_file, size + 10, SEEK_SET);
-    /* writing data to temp file */
-    prepend_new_tag(temp, tag);
-    while (!feof(audio_file)) {
-        fputc(fgetc(audio_file), temp);
-    }
-    rewind(temp);
-    rewind(audio_file);
+/*
+ * writes header, frames and padding up to size at the current position,
+ * a footer after them if asked to, which is how a tag at the end of a file is found
+ */
+int write_tag(FILE *file, struct id3tag *tag, unsigned size, bool footer) {
+    /* the extended header is not written */
+    char flags = (tag->flags & ~(EXTENDED_HEADER_BIT | FOOTER_BIT)) | (footer ? FOOTER_BIT : 0);
+    write_tag_header(file, ID3_IDENTIFIER, flags, size);
+
+    /* writing frames as they are stored, unsynchronising them if the tag is */
+    for (struct frame *frame = tag->frames; frame < tag->frames + tag->frame_count; ++frame) {
+        if (frame->source_size) {
+            char header[10];
+            memcpy(header, frame->id, 4);
+            to_synchsafe32(frame->size, header + 4);
+            memcpy(header + 8, frame->flags, 2);
+            if (fflush(file) != 0 or write_source_frame(fileno(file), header, frame) != 0)
+                return -1;
+            continue;
+        }
+        fwrite(frame->id, 1, 4, file);
+        write_synchsafe32(file, written_size(frame, tag));
+        fputc(frame->flags[0], file);
+        if (unsync_on_write(frame, tag)) {
+            fputc(frame->flags[1] | UNSYCHRONISATION_BIT, file);
+            write_unsync(file, stored_data(frame, tag), frame->size);
+        }
+        else {
+            fputc(frame->flags[1], file);
+            fwrite(stored_data(frame, tag), 1, frame->size, file);
+        }
+    }
 
-    while (!feof(temp)) {
-        fputc(fgetc(temp), audio_file);
+    for (unsigned i = frames_size(tag); i < size; ++i) {
+        fputc(0, file);
     }
+    if (footer)
+        write_tag_header(file, ID3_BACK_IDENTIFIER, flags, size);
+    return 0;
+}
 
-    fclose(temp);
-    fclose(audio_file);
+/*
+ * a mapped frame written further from the start than it is now, or growing by
+ * unsynchronisation, would overwrite the bytes after it before they are written,
+ * such frames are copied into memory
+ */
+void keep_moved_frames(struct id3tag *tag, long offset) {
+    long destination = offset + 10;
+    for (struct frame *frame = tag->frames; frame < tag->frames + tag->frame_count; ++frame) {
+        unsigned size = written_size(frame, tag);
+        destination += 10;
+        if (tag->mapped and frame->data == NULL and (frame->offset < destination or size != frame->size)) {
+            void *mapped = stored_data(frame, tag);
+            frame->data = malloc(frame->size);
+            memcpy(frame->data, mapped, frame->size);
+        }
+        destination += size;
+    }
 }
 
-/* WIP */
-void update_id3v2_tag(char *filename, struct frame *frames, int count) {
+/* the shared mapping sees what has been written, mapped frames are now where they were written to */
+void follow_written_frames(struct id3tag *tag, long offset) {
+    long destination = offset + 10;
+    for (struct frame *frame = tag->frames; frame < tag->frames + tag->frame_count; ++frame) {
+        destination += 10;
+        if (tag->mapped and frame->data == NULL)
+            frame->offset = destination;
+        destination += written_size(frame, tag);
+    }
+}
+
+/*
+ * overwrites the tag in place when the frames fit into its size and padding,
+ * otherwise writes a new tag and the audio into a temporary file and renames it over the old one
+ */
+int write_id3v2_tag(char *filename, struct id3tag *tag) {
     FILE *audio_file = fopen(filename, "r+b");
     struct id3tag present;
+    unsigned available = 0, needed;
+    long tag_start = 0, audio_start = 0;
+
+    /* the tag is written as ID3v2.4, where compressed frames read from the file have their data length in another form */
+    for (struct frame *frame = tag->frames; frame < tag->frames + tag->frame_count and tag->version[0] < 4; ++frame) {
+        if (frame->data == NULL and frame->flags[1] & DATA_LENGTH_INDICATOR_BIT)
+            frame_data(frame, tag);
+    }
+    /* payloads left in their files are read when they have to be unsynchronised */
+    for (struct frame *frame = tag->frames; frame < tag->frames + tag->frame_count; ++frame) {
+        if (frame->source_size and unsync_on_write(frame, tag))
+            frame_data(frame, tag);
+    }
+    needed = frames_size(tag);
     if (audio_file == NULL) {
         fprintf(stderr, "Cannot open file '%s'\n", filename);
-        exit(EXIT_FAILURE);
+        return -1;
     }
-    present.offset = search_id3_identifier(audio_file);
-    if (present.offset < 0) {
-        fprintf(stderr, "ID3 tag was not found in '%s'\n", filename);
-        exit(EXIT_FAILURE);
+    if (read_tag_header(audio_file, &present) >= 0) {
+        free(present.extended_header);
+        available = present.size;
+        tag_start = present.offset;
+        audio_start = present.offset + 10 + available + (present.flags & FOOTER_BIT ? 10 : 0);
+        if (needed <= available) {
+            int status;
+            keep_moved_frames(tag, present.offset);
+            fseek(audio_file, present.offset, SEEK_SET);
+            status = write_tag(audio_file, tag, available, present.flags & FOOTER_BIT);
+            if (fclose(audio_file) != 0)
+                status = -1;
+            follow_written_frames(tag, present.offset);
+            tag->size = available;
+            tag->version[0] = ID3V2_VERSION;
+            return status;
+        }
     }
 
+    /* the new file is built next to the old one and replaces it at once */
+    char temp_name[strlen(filename) + 8];
+    struct stat st;
+    int temp, status = 0;
+    FILE *temp_file;
+
+    sprintf(temp_name, "%s.XXXXXX", filename);
+    if ((temp = mkstemp(temp_name)) < 0 or (temp_file = fdopen(temp, "wb")) == NULL) {
+        fprintf(stderr, "Cannot create a temporary file next to '%s'\n", filename);
+        if (temp >= 0) {
+            close(temp);
+            unlink(temp_name);
+        }
+        fclose(audio_file);
+        return -1;
+    }
+    tag->size = needed + MINIMUM_PADDING;
+    /* everything but the old tag is kept, audio in front of an appended tag too */
+    if (write_tag(temp_file, tag, tag->size, false) != 0
+            or fflush(temp_file) != 0
+            or fstat(fileno(audio_file), &st) != 0
+            or lseek(fileno(audio_file), 0, SEEK_SET) < 0
+            or copy_range(fileno(audio_file), temp, tag_start) != 0
+            or lseek(fileno(audio_file), audio_start, SEEK_SET) < 0
+            or copy_range(fileno(audio_file), temp, st.st_size - audio_start) != 0
+            or fchmod(temp, st.st_mode & 07777) != 0
+            or fsync(temp) != 0) {
+        status = -1;
+    }
+    if (fclose(temp_file) != 0)
+        status = -1;
+    fclose(audio_file);
+
+    if (status == 0 and rename(temp_name, filename) != 0)
+        status = -1;
+    if (status == 0)
+        tag->version[0] = ID3V2_VERSION;
+    if (status != 0) {
+        fprintf(stderr, "Cannot rewrite '%s': %s\n", filename, strerror(errno));
+        unlink(temp_name);
+    }
+    return status;
 }
 
+/* replaces frames with the same ids or adds new ones, then writes the tag back */
 void put_text_frame(char id[4], char *str, struct id3tag *tag) {
     if (memcmp(id, "COMM", 4) == 0) {
-        struct frame new;
+        struct frame new = { .source_size = 0 };
         memcpy(new.id, id, 4);
         memset(new.flags, 0, 2);
         new.size = strlen(str) + 5;
@@ -268,13 +764,14 @@ void put_text_frame(char id[4], char *str, struct id3tag *tag) {
         struct frame *existing = get_frame(id, tag);
         if (existing) {
             existing->size = strlen(str) + 1;
+            existing->flags[1] &= ~(COMPRESSION_BIT | UNSYCHRONISATION_BIT | DATA_LENGTH_INDICATOR_BIT);
             existing->data = realloc(existing->data, existing->size);
             ((char *)existing->data)[0] = 0;
             memcpy(existing->data + 1, str, existing->size - 1);
             return;
         }
     }
-    struct frame new;
+    struct frame new = { .source_size = 0 };
     memcpy(new.id, id, 4);
     memset(new.flags, 0, 2);
     new.size = strlen(str) + 1;
@@ -329,12 +826,7 @@ int put_picture_frame(char *filename, bool ref, char type, char *description, st
         cursor += strlen(description) + 1;
         memcpy(cursor, filename, strlen(filename));
 
-        struct frame new = {
-            "APIC",
-            size,
-            {0, 0},
-            data
-        };
+        struct frame new = { .id = "APIC", .size = size, .data = data };
         put_frame(new, tag);
         return 0;
     }
@@ -350,16 +842,19 @@ int put_picture_frame(char *filename, bool ref, char type, char *description, st
         strcat(mime_type, "png");
     }
 
-    FILE *picture = fopen(filename, "r");
-    if (picture == NULL)
+    /* only the fields before the image are kept in memory, the image is copied from its file when the tag is written */
+    int picture = open(filename, O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (picture < 0)
         return 1;
+    if (fstat(picture, &st) != 0 or not S_ISREG(st.st_mode)) {
+        close(picture);
+        return 1;
+    }
+    if (st.st_size == 0)
+        close(picture);
 
-
-    fseek(picture, 0L, SEEK_END);
-    long filesize = ftell(picture);
-    rewind(picture);
-
-    size = 7 + strlen(mime_type) + strlen(description) + filesize;
+    size = 4 + strlen(mime_type) + strlen(description);
 
     data = malloc(size);
     cursor = data;
@@ -370,39 +865,36 @@ int put_picture_frame(char *filename, bool ref, char type, char *description, st
     *cursor = type;
     cursor++;
     strcpy(cursor, description);
-    cursor += strlen(description) + 1;
-    while (!feof(picture)) {
-        *cursor = fgetc(picture);
-        cursor++;
-    }
 
     struct frame new = {
-        "APIC",
-        size,
-        {0, 0},
-        data
+        .id = "APIC", .size = size + st.st_size, .data = data,
+        .source = picture, .source_offset = 0, .source_size = st.st_size
     };
     put_frame(new, tag);
     return 0;
 }
 
-void text_frame_to_str(struct frame *text_frame, char *buf) {
+void text_frame_to_str(struct frame *text_frame, struct id3tag *tag, char *buf) {
+    char *data = frame_data(text_frame, tag);
     if (text_frame->id[0] == 'T') {
-        memcpy(buf, text_frame->data + 1, text_frame->size - 1);
-        buf[text_frame->size] = '\0';
+        size_t length = text_frame->size ? text_frame->size - 1 : 0;
+        memcpy(buf, data + 1, length);
+        buf[length] = '\0';
         return;
     }
     else if (memcmp(text_frame->id, "COMM", 4) == 0) {
-        strcpy(buf, text_frame->data + 4);
-        strcat(buf, strlen(text_frame->data + 4) ? ": " : "");
-        strncat(buf, text_frame->data + strlen(text_frame->data + 4) + 5, 
-            text_frame->size - strlen(text_frame->data + 4) - 5);
+        /* the frame comes from the file, neither the description nor the text has to end in it */
+        size_t size = text_frame->size > 4 ? text_frame->size - 4 : 0,
+            description = strnlen(data + 4, size),
+            rest = description < size ? size - description - 1 : 0;
+        sprintf(buf, "%.*s%s%.*s", (int)description, data + 4, description ? ": " : "",
+            (int)strnlen(data + 5 + description, rest), data + 5 + description);
     }
     else if (memcmp(text_frame->id, "APIC", 4) == 0) {
-        char *cur = text_frame->data + strlen(text_frame->data + 1) + 3;
+        char *cur = data + strlen(data + 1) + 3;
         strcpy(buf, cur);
         strcat(buf, "[");
-        strcat(buf, text_frame->data + 1);
+        strcat(buf, data + 1);
         strcat(buf, "]");
     }
 }
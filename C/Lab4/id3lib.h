@@ -2,10 +2,14 @@
 #include <time.h>
 #define ID3_IDENTIFIER "ID3"
 #define ID3_BACK_IDENTIFIER "3DI"
+#define ID3V1_IDENTIFIER "TAG"
+#define ID3V1_SIZE 128
 #define ID3V2_VERSION 04
 #define ID3V2_REVISION 00
 
 #define MINIMUM_PADDING 1024
+/* how far from the start of a file a tag is looked for */
+#define SEARCH_WINDOW 4096
 
 #define UNSYNCHRONISATION_BIT   0b10000000
 #define EXTENDED_HEADER_BIT     0b01000000
@@ -40,11 +44,25 @@
 
 #define SYNCHSAFE_MASK 0x7f
 
+/* frames smaller than this are not worth compressing */
+#define COMPRESS_MIN_SIZE 256
+
+/* initial number of frame index slots, a power of two */
+#define FRAME_INDEX_SIZE 32
+
 struct frame {
     char id[4];
     unsigned int size;
     char flags[2];
+    /* a changed payload, NULL while it is still the one at offset in the file */
     void *data;
+    long offset;
+    /* index of the next frame with the same id, -1 for the last one */
+    int next;
+    /* the last source_size bytes of the payload are not in data but in the open file source at source_offset */
+    int source;
+    long source_offset;
+    unsigned source_size;
 };
 
 struct id3tag {
@@ -56,19 +74,29 @@ struct id3tag {
     char extended_flags;
     char *extended_header;
     char restrictions;
-    struct frame_list *first;
-};
-
-struct frame_list {
-    struct frame frame;
-    struct frame_list *next;
+    /* frames in file order */
+    struct frame *frames;
+    int frame_count, frame_capacity;
+    /* open addressing by id, each slot holds the first frame with the id or -1 */
+    int *index;
+    int index_size;
+    /* the file up to the end of the tag, from map_start on, mapped or read into memory */
+    char *map;
+    size_t map_size;
+    long map_start;
+    bool mapped;
 };
 
 int read_id3v2_tag(FILE *audio_file, struct id3tag *buf);
-void write_id3v2_tag(char *audio_file, struct id3tag *tag);
+int write_id3v2_tag(char *audio_file, struct id3tag *tag);
 void free_id3v2_tag(struct id3tag *tag);
 struct frame *get_frame(char *id, struct id3tag *tag);
+struct frame *next_frame(struct frame *frame, struct id3tag *tag);
+bool has_frame(char id[4], struct id3tag *tag);
 void put_frame(struct frame value, struct id3tag *tag);
+void remove_frame(char id[4], struct id3tag *tag);
 void put_text_frame(char id[4], char *str, struct id3tag *tag);
 int put_picture_frame(char *filename, bool ref, char type, char *description, struct id3tag *tag);
-void text_frame_to_str(struct frame *text_frame, char *buf);
\ No newline at end of file
+void *frame_data(struct frame *frame, struct id3tag *tag);
+void compress_frames(struct id3tag *tag, unsigned min_size);
+void text_frame_to_str(struct frame *text_frame, struct id3tag *tag, char *buf);
\ No newline at end of file
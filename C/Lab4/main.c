@@ -1,111 +1,381 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
 #include <iso646.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <glob.h>
+#include <ftw.h>
+#include <strings.h>
+#include <sys/stat.h>
 #include "id3lib.h"
 #include "argparse.h"
+#include "catalog.h"
 
-int main(int argc, char **argv) {
-    char *filename = "", *to_get = "", *to_set = "";
-    bool rewrite = false, extract_pictures = false;
-    parse_args(argc, argv, &filename, &to_get, &to_set, &rewrite, &extract_pictures);
+struct options {
+    char *to_get, *to_set;
+    bool rewrite, extract_pictures, compress;
+    char *catalog, *query;
+    /* with a catalog and nothing else to do files are only read into it */
+    bool index_only;
+};
+
+/* one file of a batch, its output is kept until every file before it is printed */
+struct job {
+    char *path;
+    char *output;
+    size_t output_size;
+    int status;
+    /* set when the catalog entry of the file is up to date, otherwise the file is read into own */
+    bool cached;
+    struct catalog own;
+};
+
+struct file_list {
+    struct job *jobs;
+    int count, capacity;
+};
+
+struct pool {
+    struct job *jobs;
+    int count, next;
+    const struct options *options;
+};
+
+/* the list nftw() adds to, directories are walked from the main thread only */
+static struct file_list *walked;
+
+int process_file(char *filename, const struct options *options, FILE *out) {
     FILE *f = fopen(filename, "r+b");
     if (f == NULL) {
-        printf("File not opened.\n");
+        fprintf(out, "File not opened.\n");
         return 1;
     }
     struct id3tag tag;
-    
+
     switch (read_id3v2_tag(f, &tag)) {
     case TAG_NOT_FOUND:
-        printf("ID3 tag has not been found.\n");
+        fprintf(out, "ID3 tag has not been found.\n");
+        fclose(f);
         return 1;
-        break;
     case TAG_TOO_BIG_VERSION:
-        printf("ID3 tag has too big version.\n");
+        fprintf(out, "ID3 tag has too big version.\n");
+        fclose(f);
         return 1;
     }
-    if (strlen(to_get) == 0 and strlen(to_set) == 0 and not extract_pictures) {
-        char id[4], *buffer;
-        struct frame_list *list = tag.first;
-        printf("Tag ID\tData\n");
-        while (list != NULL) {
-            if (list->frame.id[0] == 'T' or list->frame.id[0] == 'C' or memcmp(list->frame.id, "APIC", 4) == 0) {
-                buffer = malloc(memcmp(list->frame.id, "APIC", 4) == 0 ? 1024 : list->frame.size);
-                memcpy(id, list->frame.id, 4);
-                text_frame_to_str(&list->frame, buffer);
-                printf("%4s\t%s\n", id, buffer);
+    fclose(f);
+    /* strtok_r() cuts the lists, every file gets its own copy */
+    char to_get[strlen(options->to_get) + 1], to_set[strlen(options->to_set) + 1], *save;
+    strcpy(to_get, options->to_get);
+    strcpy(to_set, options->to_set);
+
+    if (strlen(to_get) == 0 and strlen(to_set) == 0 and not options->extract_pictures and not options->compress) {
+        char *buffer;
+        fprintf(out, "Tag ID\tData\n");
+        for (struct frame *frame = tag.frames; frame < tag.frames + tag.frame_count; frame++) {
+            if (frame->id[0] == 'T' or frame->id[0] == 'C' or memcmp(frame->id, "APIC", 4) == 0) {
+                /* decoding a compressed frame changes its size */
+                frame_data(frame, &tag);
+                buffer = malloc(memcmp(frame->id, "APIC", 4) == 0 ? 1024 : frame->size + 3);
+                text_frame_to_str(frame, &tag, buffer);
+                fprintf(out, "%.4s\t%s\n", frame->id, buffer);
                 free(buffer);
             }
-            list = list->next;
         }
+        free_id3v2_tag(&tag);
         return 0;
     }
     if (strlen(to_get)) {
         char *id, *buffer;
         struct frame *read;
-        printf("Tag ID\tData\n");
-        id = strtok(to_get, ",");
+        fprintf(out, "Tag ID\tData\n");
+        id = strtok_r(to_get, ",", &save);
         do {
-            if ((read = get_frame(id, &tag))) {
-                buffer = malloc(read->size);
-                text_frame_to_str(read, buffer);
-                printf("%s\t%s\n", id, buffer);
+            for (read = get_frame(id, &tag); read; read = next_frame(read, &tag)) {
+                frame_data(read, &tag);
+                buffer = malloc(read->size + 3);
+                text_frame_to_str(read, &tag, buffer);
+                fprintf(out, "%s\t%s\n", id, buffer);
                 free(buffer);
             }
-        } while ((id = strtok(NULL, ",")));
+        } while ((id = strtok_r(NULL, ",", &save)));
     }
-    if (strlen(to_set)) {
-        if (rewrite) {
+    if (strlen(to_set) or options->compress) {
+        if (options->rewrite) {
             free_id3v2_tag(&tag);
-            tag.size = MINIMUM_PADDING;
             tag.extended_header_size = 0;
             tag.extended_header = NULL;
             tag.flags = 0;
         }
-        char *buffer, *key, *value;
-        struct frame new, *existing;
-        key = strtok(to_set, "=");
-        value = strtok(NULL, ",");
-        do {
+        char *key, *value;
+        for (key = strtok_r(to_set, "=", &save), value = strtok_r(NULL, ",", &save); key and value;
+                key = strtok_r(NULL, "=", &save), value = strtok_r(NULL, ",", &save)) {
             if (key[0] == 'T' or memcmp(key, "COMM", 4) == 0) {
-                tag.size += get_frame(key, &tag) ? strlen(value) - 1 - get_frame(key, &tag)->size : strlen(value) + 11;
                 put_text_frame(key, value, &tag);
             }
             else if (strcmp(key, "APIC") == 0) {
-                char *token = strtok(value, ":"), *name = strtok(NULL, ":");
+                char *token = strtok_r(value, ":", &value), *name = strtok_r(NULL, ":", &value);
                 int type;
-                sscanf(token, "%02x", &type);
-                put_picture_frame(name, token[2] != '%', type, strtok(NULL, ","), &tag);
-                tag.size += get_frame("APIC", &tag)->size + 10;
+                /* a picture is embedded when its type is preceded by %, otherwise it is linked */
+                sscanf(token + (token[0] == '%'), "%02x", &type);
+                put_picture_frame(name, token[0] != '%', type, strtok_r(NULL, ",", &value), &tag);
+            }
+        }
+        if (options->compress)
+            compress_frames(&tag, COMPRESS_MIN_SIZE);
+        if (write_id3v2_tag(filename, &tag) != 0) {
+            free_id3v2_tag(&tag);
+            return 2;
+        }
+    }
+    if (options->extract_pictures) {
+        /* pictures are saved next to the file they come from */
+        char *base = strrchr(filename, '/');
+        int dir_length = base ? base - filename + 1 : 0;
+        base = base ? base + 1 : filename;
+        for (struct frame *frame = get_frame("APIC", &tag); frame; frame = next_frame(frame, &tag)) {
+            void *data = frame_data(frame, &tag) + 1;
+
+            char *mime = (char *)data + 1, type;
+            data += strlen(mime) + 2;
+            type = *(char *)data;
+            data += strlen(data + 1) + 2;
+            /* linked pictures have no data */
+            if (strchr(mime, '/') == NULL)
+                continue;
+            char picture_name[strlen(filename) + strlen(mime) + 4];
+            sprintf(picture_name, "%.*s%x_%s.%s", dir_length, filename, type, base, strchr(mime, '/') + 1);
+            FILE *picture = fopen(picture_name, "wb");
+            if (picture == NULL) {
+                fprintf(out, "Error: Could not write to file '%s'\n", picture_name);
+                free_id3v2_tag(&tag);
+                return 3;
             }
-        } while ((key = strtok(NULL, "="), value = strtok(NULL, ",")));
-        write_id3v2_tag(filename, &tag);
-    }
-    if (extract_pictures) {
-        struct frame_list *list = tag.first;
-        while (list) {
-            if (memcmp(list->frame.id, "APIC", 4) == 0) {
-                void *data = list->frame.data + 1;
-
-                char *mime = (char *)data + 1, type;
-                data += strlen(mime) + 2;
-                type = *(char *)data;
-                data += strlen(data + 1) + 2;
-                char picture_name[strlen(filename) + 10];
-                sprintf(picture_name, "%x_%s.%s", type, filename, strchr(mime, '/') + 1);
-                FILE *picture = fopen(picture_name, "wb");
-                if (picture == NULL) {
-                    fprintf(stderr, "%s: Error: Could not write to file '%s'\n", argv[0], picture_name);
-                    return 3;
-                }
-                for (char *copy = data; copy < (char *)list->frame.data + list->frame.size; copy++) {
-                    fputc(*copy, picture);
-                }
-                fclose(picture);
+            fwrite(data, 1, (char *)frame_data(frame, &tag) + frame->size - (char *)data, picture);
+            fclose(picture);
+        }
+    }
+    free_id3v2_tag(&tag);
+    return 0;
+}
+
+void add_file(struct file_list *files, const char *path) {
+    if (files->count == files->capacity) {
+        files->capacity = files->capacity ? 2 * files->capacity : 64;
+        files->jobs = realloc(files->jobs, files->capacity * sizeof(struct job));
+    }
+    files->jobs[files->count++] = (struct job) { .path = strdup(path) };
+}
+
+int add_walked(const char *path, const struct stat *info, int type, struct FTW *ftw) {
+    const char *extension = strrchr(path + ftw->base, '.');
+    if (type == FTW_F and S_ISREG(info->st_mode) and extension and strcasecmp(extension, ".mp3") == 0)
+        add_file(walked, path);
+    return 0;
+}
+
+int compare_jobs(const void *a, const void *b) {
+    return strcmp(((const struct job *)a)->path, ((const struct job *)b)->path);
+}
+
+/* directories are walked for mp3 files in path order, anything else is taken as is */
+void add_path(struct file_list *files, const char *path) {
+    struct stat info;
+    if (stat(path, &info) == 0 and S_ISDIR(info.st_mode)) {
+        int first = files->count;
+        walked = files;
+        nftw(path, add_walked, 32, FTW_PHYS);
+        qsort(files->jobs + first, files->count - first, sizeof(struct job), compare_jobs);
+    }
+    else {
+        add_file(files, path);
+    }
+}
+
+/* adds the text frames of a file to the catalog, a file without a tag gets an entry with none */
+void index_file(char *filename, struct catalog *catalog) {
+    FILE *f = fopen(filename, "rb");
+    struct stat info;
+    struct id3tag tag;
+    if (f == NULL or fstat(fileno(f), &info) != 0) {
+        if (f)
+            fclose(f);
+        return;
+    }
+    catalog_add(catalog, filename, &info);
+    if (read_id3v2_tag(f, &tag) == 0) {
+        for (struct frame *frame = tag.frames; frame < tag.frames + tag.frame_count; frame++) {
+            if (frame->id[0] == 'T' or memcmp(frame->id, "COMM", 4) == 0) {
+                frame_data(frame, &tag);
+                /* the size comes from the file, it may be too much for the stack */
+                char *buffer = malloc(frame->size + 3);
+                if (buffer == NULL)
+                    continue;
+                text_frame_to_str(frame, &tag, buffer);
+                catalog_add_frame(catalog, frame->id, buffer);
+                free(buffer);
+            }
+        }
+        free_id3v2_tag(&tag);
+    }
+    fclose(f);
+}
+
+/*
+ * the entries of the files just read or found unchanged, and the old entries
+ * of other files that still exist
+ */
+void update_catalog(struct catalog *catalog, struct job *jobs, int count) {
+    struct catalog updated = { 0 };
+    for (int i = 0; i < count; i++) {
+        if (jobs[i].cached)
+            catalog_copy(&updated, catalog, catalog_find(catalog, jobs[i].path));
+        else if (jobs[i].own.count)
+            catalog_copy(&updated, &jobs[i].own, &jobs[i].own.entries[0]);
+        catalog_free(&jobs[i].own);
+    }
+    catalog_sort(&updated);
+
+    size_t listed = updated.count;
+    for (struct catalog_entry *entry = catalog->entries; entry < catalog->entries + catalog->count; entry++) {
+        /* the entries copied here are not sorted, only the listed ones are searched */
+        struct catalog sorted = updated;
+        struct stat info;
+        sorted.count = listed;
+        if (catalog_find(&sorted, catalog_path(catalog, entry)) == NULL and stat(catalog_path(catalog, entry), &info) == 0)
+            catalog_copy(&updated, catalog, entry);
+    }
+    catalog_free(catalog);
+    *catalog = updated;
+}
+
+/* prints the files with a frame ID, or with a frame ID=VALUE, in path order */
+void query_catalog(struct catalog *catalog, char *query) {
+    size_t id_length = strcspn(query, "=");
+    char *value = query[id_length] ? query + id_length : NULL;
+    for (struct catalog_entry *entry = catalog->entries; entry < catalog->entries + catalog->count; entry++) {
+        for (unsigned long long i = 0; i < entry->frame_count; i++) {
+            const struct catalog_frame *frame = &catalog->frames[entry->first_frame + i];
+            if (id_length == 4 and memcmp(frame->id, query, 4) == 0
+                    and (value == NULL or strcmp(catalog_value(catalog, frame), value + 1) == 0)) {
+                printf("%s\n", catalog_path(catalog, entry));
+                break;
+            }
+        }
+    }
+}
+
+/* workers take the next file until none are left, results stay in argument order */
+void *tag_worker(void *arg) {
+    struct pool *pool = arg;
+    int i;
+    while ((i = __atomic_fetch_add(&pool->next, 1, __ATOMIC_RELAXED)) < pool->count) {
+        struct job *job = &pool->jobs[i];
+        FILE *out = open_memstream(&job->output, &job->output_size);
+        if (not pool->options->index_only)
+            job->status = process_file(job->path, pool->options, out);
+        fclose(out);
+        if (pool->options->catalog and not job->cached)
+            index_file(job->path, &job->own);
+    }
+    return NULL;
+}
+
+void process_files(struct job *jobs, int count, int workers, const struct options *options) {
+    struct pool pool = { jobs, count, 0, options };
+    if (workers <= 0)
+        workers = sysconf(_SC_NPROCESSORS_ONLN);
+    if (workers > count)
+        workers = count;
+
+    pthread_t threads[workers];
+    bool started[workers];
+    for (int i = 1; i < workers; i++)
+        started[i] = pthread_create(&threads[i], NULL, tag_worker, &pool) == 0;
+    tag_worker(&pool);
+    for (int i = 1; i < workers; i++)
+        if (started[i])
+            pthread_join(threads[i], NULL);
+}
+
+int main(int argc, char **argv) {
+    char **paths = NULL;
+    struct options options = { "", "", false, false, false, NULL, NULL, false };
+    struct catalog catalog;
+    int jobs = 0, status = 0;
+    parse_args(argc, argv, &paths, &options.to_get, &options.to_set, &options.rewrite, &options.extract_pictures,
+        &options.compress, &jobs, &options.catalog, &options.query);
+
+    if (paths == NULL and options.catalog == NULL) {
+        fprintf(stderr, "Error: No MP3 file provided\n");
+        return 1;
+    }
+    if (options.catalog and catalog_load(options.catalog, &catalog) != 0) {
+        fprintf(stderr, "%s: '%s' is not a catalog file\n", argv[0], options.catalog);
+        return 1;
+    }
+    options.index_only = options.catalog and not strlen(options.to_get) and not strlen(options.to_set)
+        and not options.extract_pictures and not options.compress;
+
+    /* a single file is processed as before, anything more is a batch */
+    struct file_list files = { NULL, 0, 0 };
+    bool batch = options.catalog or (paths and paths[1] != NULL);
+    for (char **path = paths; path and *path; path++) {
+        glob_t matches;
+        struct stat info;
+        if (strpbrk(*path, "*?[") and glob(*path, 0, NULL, &matches) == 0) {
+            for (size_t i = 0; i < matches.gl_pathc; i++)
+                add_path(&files, matches.gl_pathv[i]);
+            globfree(&matches);
+            batch = true;
+            continue;
+        }
+        if (stat(*path, &info) == 0 and S_ISDIR(info.st_mode))
+            batch = true;
+        add_path(&files, *path);
+    }
+    free(paths);
+
+    if (not batch) {
+        status = process_file(files.jobs[0].path, &options, stdout);
+        free(files.jobs[0].path);
+        free(files.jobs);
+        return status;
+    }
+
+    /* only files changed since they were read into the catalog are read again */
+    for (int i = 0; options.catalog and options.index_only and i < files.count; i++) {
+        const struct catalog_entry *entry = catalog_find(&catalog, files.jobs[i].path);
+        struct stat info;
+        files.jobs[i].cached = entry and stat(files.jobs[i].path, &info) == 0 and catalog_fresh(entry, &info);
+    }
+    if (files.count > 0)
+        process_files(files.jobs, files.count, jobs, &options);
+    for (int i = 0, printed = 0; i < files.count; i++) {
+        if (files.jobs[i].output_size)
+            printf("%s%s:\n", printed++ ? "\n" : "", files.jobs[i].path);
+        fwrite(files.jobs[i].output, 1, files.jobs[i].output_size, stdout);
+        if (files.jobs[i].status > status)
+            status = files.jobs[i].status;
+        free(files.jobs[i].output);
+    }
+
+    if (options.catalog) {
+        if (files.count > 0) {
+            update_catalog(&catalog, files.jobs, files.count);
+            if (catalog_save(options.catalog, &catalog) != 0) {
+                fprintf(stderr, "%s: Could not write catalog '%s'\n", argv[0], options.catalog);
+                status = 1;
             }
-            list = list->next;
         }
+        if (options.query)
+            query_catalog(&catalog, options.query);
+        catalog_free(&catalog);
     }
-}
\ No newline at end of file
+    for (int i = 0; i < files.count; i++)
+        free(files.jobs[i].path);
+    free(files.jobs);
+    return status;
+}
@@ -0,0 +1,189 @@
+#!/bin/sh
+
+# every test builds its files in a temporary directory, the audio is a pattern no tag search can match
+temp=$(mktemp -d)
+yes 'audio frame' | head -c 20000 > $temp/audio
+
+# four bytes of a size, synchsafe or plain
+synchsafe() {
+	printf "\\\\%03o" $(($1 >> 21 & 127)) $(($1 >> 14 & 127)) $(($1 >> 7 & 127)) $(($1 & 127))
+}
+plain() {
+	printf "\\\\%03o" $(($1 >> 24 & 255)) $(($1 >> 16 & 255)) $(($1 >> 8 & 255)) $(($1 & 255))
+}
+
+# frame VERSION ID TEXT [STATUS_FLAGS]: a text frame in ISO-8859-1, the text has no spaces
+frame() {
+	local size=$((${#3} + 1))
+	printf '%s' $2
+	printf "$( (( $1 == 4 )) && synchsafe $size || plain $size)\\$(printf %03o ${4:-0})\\000\\000%s" "$3"
+}
+
+# tag VERSION PADDING FRAMES...: a tag header with the frames and that much padding after them
+tag() {
+	local version=$1 padding=$2 frames
+	shift 2
+	frames=$(mktemp)
+	for f in "$@"; do
+		frame $version $f >> $frames
+	done
+	head -c $padding /dev/zero >> $frames
+	printf "ID3\\$(printf %03o $version)\\000\\000$(synchsafe $(stat -c %s $frames))"
+	cat $frames
+	rm $frames
+}
+
+# check NAME CONDITION MESSAGE
+check() {
+	if eval "$2"; then
+		echo -e "Test \e[33;1m$1 \e[32mpassed\e[0m "
+	else
+		echo -e "Test \e[33;1m$1 \e[31mFAILED\e[0m [$3]"
+	fi
+}
+
+get() {
+	./a.out $1 -g $2 | tail -n 1 | cut -f 2
+}
+
+# ID3v2.3 tags over 127 bytes: the tag size is synchsafe in every version, unlike the frame sizes
+title=$(printf 'Title%.0s' {1..30})
+{ tag 3 0 "TIT2 $title" "TPE1 Artist"; cat $temp/audio; } > $temp/v3.mp3
+size=$(stat -c %s $temp/v3.mp3)
+./a.out $temp/v3.mp3 -s TPE1=Other
+check "v2.3 in place" '[[ $(stat -c %s $temp/v3.mp3) -eq $size && $(get $temp/v3.mp3 TPE1) == Other
+	&& $(get $temp/v3.mp3 TIT2) == $title ]] && cmp -s <(tail -c 20000 $temp/v3.mp3) $temp/audio' \
+	"size $(stat -c %s $temp/v3.mp3) of $size, TPE1 $(get $temp/v3.mp3 TPE1)"
+
+# ID3v2.4 tag with padding: written over itself, the audio stays where it is
+{ tag 4 500 "TIT2 Title" "TALB Album"; cat $temp/audio; } > $temp/v4.mp3
+size=$(stat -c %s $temp/v4.mp3)
+./a.out $temp/v4.mp3 -s TIT2=Another,COMM=Comment
+check "v2.4 in place" '[[ $(stat -c %s $temp/v4.mp3) -eq $size && $(get $temp/v4.mp3 TIT2) == Another
+	&& $(get $temp/v4.mp3 TALB) == Album ]] && cmp -s <(tail -c 20000 $temp/v4.mp3) $temp/audio' \
+	"size $(stat -c %s $temp/v4.mp3) of $size, TIT2 $(get $temp/v4.mp3 TIT2)"
+
+# an appended tag keeps its footer and the ID3v1 block after it
+v1=$(printf 'TAG%125s' '')
+tag 4 100 "TIT2 Appended" > $temp/tag
+printf '\020' | dd of=$temp/tag bs=1 seek=5 conv=notrunc status=none
+{ cat $temp/audio $temp/tag; printf "3DI\004\000\020$(synchsafe $(($(stat -c %s $temp/tag) - 10)))%s" "$v1"; } > $temp/app.mp3
+size=$(stat -c %s $temp/app.mp3)
+./a.out $temp/app.mp3 -s TIT2=Changed
+check "appended in place" '[[ $(stat -c %s $temp/app.mp3) -eq $size && $(get $temp/app.mp3 TIT2) == Changed
+	&& $(tail -c 128 $temp/app.mp3) == "$v1" ]] && cmp -s <(head -c 20000 $temp/app.mp3) $temp/audio' \
+	"size $(stat -c %s $temp/app.mp3) of $size, TIT2 $(get $temp/app.mp3 TIT2)"
+
+# frames that do not fit make a new file: the audio after the old tag is copied from where it really starts
+long=$(printf 'Long%.0s' {1..100})
+for version in 3 4; do
+	{ tag $version 0 "TIT2 $title" "TPE1 Artist"; cat $temp/audio; } > $temp/grow.mp3
+	./a.out $temp/grow.mp3 -s TALB=$long
+	check "v2.$version rewrite" '[[ $(get $temp/grow.mp3 TALB) == $long && $(get $temp/grow.mp3 TIT2) == $title ]] &&
+		cmp -s <(tail -c 20000 $temp/grow.mp3) $temp/audio' \
+		"size $(stat -c %s $temp/grow.mp3), TALB $(get $temp/grow.mp3 TALB | head -c 20)"
+done
+
+# ID3v2.3 frame status flags are moved to their ID3v2.4 bits when the tag is written as ID3v2.4
+{ tag 3 0 "TIT2 Title 128" "TPE1 Artist 64" "TALB Album 32"; cat $temp/audio; } > $temp/flags.mp3
+./a.out $temp/flags.mp3 -s TIT2=$long
+flags=$(for id in TIT2 TPE1 TALB; do
+	at=$(grep -oba $id $temp/flags.mp3 | head -n 1 | cut -d : -f 1)
+	od -An -tx1 -j $((at + 8)) -N 2 $temp/flags.mp3
+done | tr -s ' \n' ' ')
+check "v2.3 round trip" '[[ $(head -c 4 $temp/flags.mp3) == $(printf "ID3\004") && "$flags" == " 40 00 20 00 10 00 "
+	&& $(get $temp/flags.mp3 TPE1) == Artist && $(get $temp/flags.mp3 TALB) == Album ]] &&
+	cmp -s <(tail -c 20000 $temp/flags.mp3) $temp/audio' "frame flags$flags"
+
+# a tag is found by its header at the start, even one that is nothing but the header,
+# or by the footer at the very end or in front of an ID3v1 block
+printf 'ID3\004\000\000\000\000\000\000' > $temp/empty.mp3
+tag 4 0 "TIT2 Footer" > $temp/tag
+printf '\020' | dd of=$temp/tag bs=1 seek=5 conv=notrunc status=none
+{ cat $temp/audio $temp/tag; printf "3DI\004\000\020$(synchsafe $(($(stat -c %s $temp/tag) - 10)))"; } > $temp/footer.mp3
+check "tag search" '[[ $(./a.out $temp/empty.mp3) == "Tag ID	Data" && $(get $temp/footer.mp3 TIT2) == Footer
+	&& $(get $temp/app.mp3 TIT2) == Changed && $(./a.out $temp/audio) == "ID3 tag has not been found." ]]' \
+	"header only: $(./a.out $temp/empty.mp3 | tail -n 1), footer: $(get $temp/footer.mp3 TIT2)"
+
+# the audio in front of an appended tag is kept, the new tag goes to the start
+cp $temp/app.mp3 $temp/grow.mp3
+./a.out $temp/grow.mp3 -s TALB=$long
+check "appended rewrite" '[[ $(get $temp/grow.mp3 TALB) == $long && $(get $temp/grow.mp3 TIT2) == Changed ]] &&
+	cmp -s <(tail -c $((20000 + 128)) $temp/grow.mp3) <(cat $temp/audio; printf "%s" "$v1")' \
+	"size $(stat -c %s $temp/grow.mp3), TALB $(get $temp/grow.mp3 TALB | head -c 20)"
+
+# unchanged payloads are written from the mapping of the file itself: frames moved towards
+# the end by a longer one in front of them must not be overwritten before they are written
+{ tag 4 1000 "TIT2 Short" "TALB $title" "TPE1 $long" "TCON Genre"; cat $temp/audio; } > $temp/moved.mp3
+size=$(stat -c %s $temp/moved.mp3)
+./a.out $temp/moved.mp3 -s TIT2=$title$title > /dev/null
+grown=$(./a.out $temp/moved.mp3 -g TALB,TPE1,TCON | tail -n +2 | cut -f 2 | tr "\n" " ")
+./a.out $temp/moved.mp3 -s TIT2=Short > /dev/null
+shrunk=$(./a.out $temp/moved.mp3 -g TIT2,TALB,TPE1,TCON | tail -n +2 | cut -f 2 | tr "\n" " ")
+check "mapped payloads" '[[ $(stat -c %s $temp/moved.mp3) -eq $size && $grown == "$title $long Genre "
+	&& $shrunk == "Short $title $long Genre " ]] && cmp -s <(tail -c 20000 $temp/moved.mp3) $temp/audio' \
+	"grown: $(head -c 40 <<< "$grown"), shrunk: $(head -c 40 <<< "$shrunk")"
+
+# unsynchronised frames and ID3v2.3 tags are decoded, frames of an unsynchronised tag are
+# written unsynchronised, -z compresses large frames and they read back the same
+{ printf "ID3\004\000\000$(synchsafe 15)TIT2$(synchsafe 5)\000\002\000a\377\000b"; cat $temp/audio; } > $temp/unsync.mp3
+{ printf "ID3\003\000\200$(synchsafe 15)TIT2$(plain 4)\000\000\000a\377\000b"; cat $temp/audio; } > $temp/unsync3.mp3
+{ printf "ID3\004\000\200$(synchsafe 100)TIT2$(synchsafe 3)\000\000\000ab"; head -c 87 /dev/zero; cat $temp/audio; } > $temp/encode.mp3
+./a.out $temp/encode.mp3 -s TPE1=$'x\xff\xe0y' > /dev/null
+{ tag 4 0 "TIT2 Title" "TALB $long"; cat $temp/audio; } > $temp/zlib.mp3
+./a.out $temp/zlib.mp3 -z > /dev/null
+at=$(grep -oba TALB $temp/zlib.mp3 | head -n 1 | cut -d : -f 1)
+decoded=$'a\xffb' encoded=$'x\xff\xe0y' false_sync=$'\xff\xe0'
+check "unsync and zlib" '[[ $(get $temp/unsync.mp3 TIT2) == "$decoded" && $(get $temp/unsync3.mp3 TIT2) == "$decoded" &&
+	$(get $temp/encode.mp3 TPE1) == "$encoded" && $(get $temp/zlib.mp3 TALB) == $long &&
+	$(od -An -tx1 -j $((at + 9)) -N 1 $temp/zlib.mp3) == " 09" ]] && ! grep -q $long $temp/zlib.mp3 &&
+	! head -c 110 $temp/encode.mp3 | LC_ALL=C grep -q "$false_sync"' \
+	"TIT2 $(get $temp/unsync.mp3 TIT2 | od -An -tx1), TPE1 $(get $temp/encode.mp3 TPE1 | od -An -tx1), TALB flags $(od -An -tx1 -j $((at + 8)) -N 2 $temp/zlib.mp3)"
+
+# embedded pictures are copied from their files when the tag is written, in place or into a new file,
+# and listed and extracted like any other picture
+head -c 300 /dev/urandom > $temp/small.png
+head -c 5000 /dev/urandom > $temp/large.jpg
+{ tag 4 1000 "TIT2 Title"; cat $temp/audio; } > $temp/art.mp3
+size=$(stat -c %s $temp/art.mp3)
+./a.out $temp/art.mp3 -s APIC=%03:$temp/small.png:Front > /dev/null
+in_place=$(stat -c %s $temp/art.mp3)
+./a.out $temp/art.mp3 -s APIC=%04:$temp/large.jpg:Back > /dev/null
+./a.out $temp/art.mp3 -x > /dev/null
+listed=$(./a.out $temp/art.mp3 | grep APIC | cut -f 2 | tr "\n" " ")
+check "pictures" '[[ $in_place -eq $size && $listed == "Front[image/png] Back[image/jpeg] " ]] &&
+	cmp -s $temp/3_art.mp3.png $temp/small.png && cmp -s $temp/4_art.mp3.jpeg $temp/large.jpg &&
+	cmp -s <(tail -c 20000 $temp/art.mp3) $temp/audio' "size $in_place of $size, listed $listed"
+
+# frames that may repeat keep every value in file order, through a rewrite as well
+{ tag 4 0 "TXXX first" "TIT2 Title" "TXXX second"; cat $temp/audio; } > $temp/multi.mp3
+./a.out $temp/multi.mp3 -s COMM=One,COMM=Two,TIT2=$long > /dev/null
+values=$(./a.out $temp/multi.mp3 -g TXXX,COMM,TIT2 | tail -n +2 | cut -f 2 | tr "\n" " ")
+check "repeated frames" '[[ $values == "first second One Two $long " ]]' "$values"
+
+# directories, globs and several files are a batch: every file is done, the output stays in path order
+mkdir $temp/lib
+for name in b a c; do
+	{ tag 4 100 "TIT2 Song_$name"; cat $temp/audio; } > $temp/lib/$name.mp3
+done
+cp $temp/lib/c.mp3 $temp/lib/d.MP3
+echo 'not a tag' > $temp/lib/notes.txt
+./a.out $temp/lib -j 4 -s TALB=Batch > /dev/null
+batch=$(./a.out $temp/lib -j 4 -g TIT2,TALB)
+check "batch" '[[ $batch == "$(./a.out $temp/lib -j 1 -g TIT2,TALB)" && $(grep -c "	Batch" <<< "$batch") -eq 4 &&
+	$(grep "^$temp" <<< "$batch" | tr -d "\n") == "$temp/lib/a.mp3:$temp/lib/b.mp3:$temp/lib/c.mp3:$temp/lib/d.MP3:" &&
+	$(grep "Song" <<< "$batch" | cut -f 2 | tr "\n" " ") == "Song_a Song_b Song_c Song_c " &&
+	$(./a.out "$temp/lib/*.mp3" -g TIT2 | grep -c "^$temp") -eq 3 ]]' "$(tr "\n" " " <<< "$batch")"
+
+# a catalog answers queries without the files, a changed file is read again, a damaged catalog is refused
+./a.out $temp/lib -C $temp/catalog
+before=$(./a.out -C $temp/catalog -q TIT2=Song_b)
+./a.out $temp/lib/b.mp3 -s TIT2=Changed > /dev/null
+./a.out $temp/lib $temp/multi.mp3 -C $temp/catalog
+after=$(./a.out -C $temp/catalog -q TIT2=Song_b; ./a.out -C $temp/catalog -q TIT2=Changed; ./a.out -C $temp/catalog -q COMM=Two)
+head -c -1 $temp/catalog > $temp/damaged
+check "catalog" '[[ $before == $temp/lib/b.mp3 && $after == "$temp/lib/b.mp3
+$temp/multi.mp3" && $(./a.out -C $temp/catalog -q TALB | wc -l) -eq 4 ]] &&
+	! ./a.out -C $temp/damaged -q TIT2 2> /dev/null' "before: $before, after: $after"
+
+rm -r $temp